@@ -223,6 +223,14 @@ public:
   {
     return state_ == State::SUSTAIN || state_ == State::DONE;
   }
+  /* upper bound for all values the envelope will produce from now on */
+  float
+  max_level() const
+  {
+    if (state_ == State::START || state_ == State::DELAY || state_ == State::ATTACK)
+      return 1;
+    return level_;
+  }
   float
   get_next()
   {
@@ -245,6 +253,100 @@ public:
       }
     return level_;
   }
+  /* render n_values envelope values at once, equivalent to calling
+   * get_next() n_values times
+   *
+   * returns the number of values until the envelope is done (including the
+   * value on which it reached the done state), or n_values if it isn't done
+   */
+  uint
+  process (float *values, uint n_values)
+  {
+    uint i = 0;
+    while (i < n_values)
+      {
+        if (state_ == State::SUSTAIN || state_ == State::DONE)
+          {
+            const uint n_active = state_ == State::DONE ? i : n_values;
+            std::fill (values + i, values + n_values, level_);
+            return n_active;
+          }
+        const uint todo = std::min<uint> (n_values - i, params_.len);
+        if (params_.factor == 1)
+          process_linear (values + i, todo);
+        else
+          process_exponential (values + i, todo);
+
+        i += todo;
+        params_.len -= todo;
+        if (!params_.len)
+          {
+            level_ = params_.end;
+            values[i - 1] = level_;
+            if (state_ == State::RELEASE)
+              {
+                state_ = State::DONE;
+                std::fill (values + i, values + n_values, level_);
+                return i;
+              }
+            else
+              {
+                next_state();
+              }
+          }
+      }
+    return n_values;
+  }
+private:
+  /* closed form of the iteration in get_next(): the values of a segment don't
+   * depend on each other, so the compiler can vectorize these loops
+   */
+  void
+  process_linear (float *values, uint n_values)
+  {
+    const double level = level_;
+    const double delta = params_.delta;
+    for (uint i = 0; i < n_values; i++)
+      values[i] = level + (i + 1) * delta;
+
+    level_ = level + n_values * delta;
+  }
+  void
+  process_exponential (float *values, uint n_values)
+  {
+    /* the level converges to c = delta / (1 - factor):
+     *
+     *   level[n] = c + (level[0] - c) * factor^n
+     */
+    constexpr uint CHUNK = 8;
+
+    const double c = params_.delta / (1 - params_.factor);
+    double powers[CHUNK];
+    double p = 1;
+    for (uint k = 0; k < CHUNK; k++)
+      {
+        p *= params_.factor;
+        powers[k] = p;
+      }
+    const double chunk_factor = p;
+
+    double d = level_ - c;
+    uint i = 0;
+    while (i + CHUNK <= n_values)
+      {
+        for (uint k = 0; k < CHUNK; k++)
+          values[i + k] = c + d * powers[k];
+        d *= chunk_factor;
+        i += CHUNK;
+      }
+    const uint rest = n_values - i;
+    for (uint k = 0; k < rest; k++)
+      values[i + k] = c + d * powers[k];
+    if (rest)
+      d *= powers[rest - 1];
+
+    level_ = c + d;
+  }
 };
 
 }
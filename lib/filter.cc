@@ -0,0 +1,25 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+#include "filter.hh"
+
+using namespace LiquidSFZInternal;
+
+/* tan (M_PI * norm_cutoff) for norm_cutoff = 2^e * (1 + j / TAN_TABLE_STEPS) */
+const std::array<float, Filter::TAN_TABLE_SIZE> Filter::tan_table = []() {
+  std::array<float, TAN_TABLE_SIZE> table;
+  for (int i = 0; i < TAN_TABLE_SIZE; i++)
+    {
+      const int e = TAN_TABLE_MIN_EXP + i / TAN_TABLE_STEPS;
+      const int j = i % TAN_TABLE_STEPS;
+      table[i] = tan (M_PI * ldexp (1 + double (j) / TAN_TABLE_STEPS, e));
+    }
+  return table;
+} ();
+
+/* 1 / q for resonance = i / RQ_TABLE_STEPS_PER_DB */
+const std::array<float, Filter::RQ_TABLE_SIZE> Filter::rq_table = []() {
+  std::array<float, RQ_TABLE_SIZE> table;
+  for (int i = 0; i < RQ_TABLE_SIZE; i++)
+    table[i] = pow (10, -double (i) / RQ_TABLE_STEPS_PER_DB / 20);
+  return table;
+} ();
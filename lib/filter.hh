@@ -3,18 +3,27 @@
 #pragma once
 
 #include <cmath>
+#include <cstring>
+#include <cstdint>
 #include <cassert>
 #include <string>
 #include <algorithm>
 #include <array>
+#include <type_traits>
+#include <utility>
+
+#include "utils.hh"
 
 typedef unsigned int uint;
 
 namespace LiquidSFZInternal
 {
 
+class FilterCascade;
+
 class Filter
 {
+  friend class FilterCascade;
 public:
   enum class Type {
     NONE,
@@ -97,6 +106,7 @@ public:
   {
     float cutoff;
     float resonance;
+    CR() = default;
     CR (float cutoff, float resonance) :
       cutoff (cutoff),
       resonance (resonance)
@@ -132,6 +142,9 @@ private:
   float last_peq_gain = 0;
   uint config_count_down = 0;
 
+  /* the filter is redesigned every CONFIG_INTERVAL frames if the parameters change */
+  static constexpr uint CONFIG_INTERVAL = 16;
+
   /* biquad */
   float a1 = 0;
   float a2 = 0;
@@ -139,43 +152,69 @@ private:
   float b1 = 0;
   float b2 = 0;
 
+  /* transposed direct form II state, one lane per channel */
   struct BiquadState
   {
-    float x1 = 0;
-    float x2 = 0;
-    float y1 = 0;
-    float y2 = 0;
+    float z1[2] = { 0, 0 };
+    float z2[2] = { 0, 0 };
   };
-  BiquadState b_state[3][2];
+  BiquadState b_state[3];
 
   Type  filter_type_ = Type::NONE;
   int   sample_rate_ = 44100;
 
-  void
-  reset_biquad (BiquadState& state)
-  {
-    state.x1 = 0;
-    state.x2 = 0;
-    state.y1 = 0;
-    state.y2 = 0;
-  }
-  float
-  apply_biquad1p (float in, BiquadState& state) /* degenerate biquad with just one pole */
+  /* Redesigning the filter is frequent if cutoff or resonance are modulated, so
+   * instead of calling tanf and exp2f, we use tables for the prewarped cutoff
+   * and for 1 / q. The tables depend on the normalized cutoff only, so they are
+   * shared between all sample rates.
+   *
+   * The tan table has TAN_TABLE_STEPS points per octave. Near nyquist, tan
+   * can't be interpolated linearly with good precision, so the table ends at
+   * sample_rate / 4 and higher cutoffs use tanf.
+   */
+  static constexpr int   TAN_TABLE_STEPS = 32;
+  static constexpr int   TAN_TABLE_MIN_EXP = -16;
+  static constexpr int   TAN_TABLE_MAX_EXP = -2;
+  static constexpr int   TAN_TABLE_SIZE = (TAN_TABLE_MAX_EXP - TAN_TABLE_MIN_EXP) * TAN_TABLE_STEPS + 1;
+  static constexpr int   TAN_TABLE_FRAC_BITS = 23 - 5; /* mantissa bits below the table index, 2^5 == TAN_TABLE_STEPS */
+  static constexpr int   RQ_TABLE_STEPS_PER_DB = 4;
+  static constexpr int   RQ_TABLE_MAX_DB = 40;
+  static constexpr int   RQ_TABLE_SIZE = RQ_TABLE_MAX_DB * RQ_TABLE_STEPS_PER_DB + 1;
+
+  static const std::array<float, TAN_TABLE_SIZE> tan_table;
+  static const std::array<float, RQ_TABLE_SIZE>  rq_table;
+
+  static float
+  prewarp (float norm_cutoff) /* tan (M_PI * norm_cutoff) */
   {
-    float out = b0 * in + b1 * state.x1 - a1 * state.y1;
-    state.x1 = in;
-    state.y1 = out;
-    return out;
+    static_assert (1 << (23 - TAN_TABLE_FRAC_BITS) == TAN_TABLE_STEPS);
+
+    constexpr float table_start = 1.f / (1 << -TAN_TABLE_MIN_EXP);
+    constexpr float table_end   = 1.f / (1 << -TAN_TABLE_MAX_EXP);
+
+    if (norm_cutoff >= table_start && norm_cutoff < table_end)
+      {
+        /* exponent and upper mantissa bits select the table entry, the remaining mantissa bits interpolate */
+        uint32_t bits;
+        memcpy (&bits, &norm_cutoff, sizeof (bits));
+
+        const uint32_t index = (bits >> TAN_TABLE_FRAC_BITS) - ((127 + TAN_TABLE_MIN_EXP) << (23 - TAN_TABLE_FRAC_BITS));
+        const float    frac  = (bits & ((1 << TAN_TABLE_FRAC_BITS) - 1)) * (1.f / (1 << TAN_TABLE_FRAC_BITS));
+        return tan_table[index] + frac * (tan_table[index + 1] - tan_table[index]);
+      }
+    return tanf (M_PI * norm_cutoff);
   }
   float
-  apply_biquad (float in, BiquadState& state)
+  resonance_to_rq (float resonance) /* 1 / q */
   {
-    float out = b0 * in + b1 * state.x1 + b2 * state.x2 - a1 * state.y1 - a2 * state.y2;
-    state.x2 = state.x1;
-    state.x1 = in;
-    state.y2 = state.y1;
-    state.y1 = out;
-    return out;
+    const float pos = resonance * RQ_TABLE_STEPS_PER_DB;
+    if (pos >= 0 && pos < RQ_TABLE_SIZE - 1)
+      {
+        const int   index = pos;
+        const float frac  = pos - index;
+        return rq_table[index] + frac * (rq_table[index + 1] - rq_table[index]);
+      }
+    return fast_db_to_factor (-resonance);
   }
   float
   fast_db_to_factor (float db)
@@ -233,7 +272,7 @@ private:
 
     if (filter_order (T) == 1) /* 1 pole filter design from DAFX, Zoelzer */
       {
-        const float k = tanf (M_PI * norm_cutoff);
+        const float k = prewarp (norm_cutoff);
         const float div_factor = 1 / (k + 1);
 
         a1 = (k - 1) * div_factor;
@@ -251,13 +290,13 @@ private:
       }
     else /* 2 pole design DAFX 2nd ed., Zoelzer */
       {
-        const float k = tanf (M_PI * norm_cutoff);
+        const float k = prewarp (norm_cutoff);
         const float kk = k * k;
-        const float q = fast_db_to_factor (resonance);
-        const float div_factor = 1  / (1 + (k + 1 / q) * k);
+        const float rq = resonance_to_rq (resonance);
+        const float div_factor = 1  / (1 + (k + rq) * k);
 
         a1 = 2 * (kk - 1) * div_factor;
-        a2 = (1 - k / q + kk) * div_factor;
+        a2 = (1 - k * rq + kk) * div_factor;
 
         if (T == Type::LPF_2P || T == Type::LPF_4P || T == Type::LPF_6P)
           {
@@ -273,7 +312,7 @@ private:
           }
         else if (T == Type::BPF_2P)
           {
-            b0 = k / q * div_factor;
+            b0 = k * rq * div_factor;
             b1 = 0;
             b2 = -b0;
           }
@@ -350,30 +389,176 @@ private:
     a2 = a2_norm * inv_a0;
   }
 
-  template<Type T, int S, int C>
-  void
-  process_biquad (float *left, float *right, uint n_frames)
+  /* left and right channel packed into the lanes of one vector */
+  typedef float StereoLanes __attribute__ ((vector_size (8)));
+
+  struct BiquadCoeffs
   {
-    BiquadState sl = b_state[S][0], sr = b_state[S][1];
+    float b0 = 0;
+    float b1 = 0;
+    float b2 = 0;
+    float a1 = 0;
+    float a2 = 0;
+  };
 
+  /* one transposed direct form II biquad stage
+   *
+   * The feedback term is subtracted last, to keep the recursive dependency
+   * chain (y -> z1 -> y) as short as possible.
+   */
+  template<bool ONE_POLE, class V>
+  static void
+  biquad_stage (const BiquadCoeffs& c, V& x, V& z1, V& z2)
+  {
+    const V y = c.b0 * x + z1;
+    if constexpr (ONE_POLE) /* degenerate biquad with just one pole */
+      {
+        z1 = c.b1 * x - c.a1 * y;
+      }
+    else
+      {
+        z1 = (c.b1 * x + z2) - c.a1 * y;
+        z2 = c.b2 * x - c.a2 * y;
+      }
+    x = y;
+  }
+  template<bool ONE_POLE, class V, size_t... S>
+  static void
+  biquad_stages (const BiquadCoeffs *coeffs, V& x, V *z1, V *z2, std::index_sequence<S...>)
+  {
+    /* stages are unrolled at compile time, so the state doesn't end up on the stack */
+    (biquad_stage<ONE_POLE> (coeffs[S], x, z1[S], z2[S]), ...);
+  }
+  /* runs STAGES cascaded biquads in one pass over the block
+   *
+   * For stereo, left and right are packed into one vector, so both channels
+   * are filtered with the same instructions. Coefficients and state are
+   * copied to local variables for the whole block, which allows the compiler
+   * to keep them in registers. Transposed direct form II needs only two state
+   * variables per stage.
+   */
+  template<int STAGES, int C, bool ONE_POLE = false>
+  static void
+  process_stages (const BiquadCoeffs *stage_coeffs, BiquadState *const *state, float *left, float *right, uint n_frames)
+  {
+    using V = std::conditional_t<C == 2, StereoLanes, float>;
+
+    BiquadCoeffs coeffs[STAGES];
+    V z1[STAGES], z2[STAGES];
+    for (int s = 0; s < STAGES; s++)
+      {
+        coeffs[s] = stage_coeffs[s];
+        if constexpr (C == 2)
+          {
+            z1[s] = V { state[s]->z1[0], state[s]->z1[1] };
+            z2[s] = V { state[s]->z2[0], state[s]->z2[1] };
+          }
+        else
+          {
+            z1[s] = state[s]->z1[0];
+            z2[s] = state[s]->z2[0];
+          }
+      }
     for (uint i = 0; i < n_frames; i++)
       {
-        if (filter_order (T) == 1)
+        V x;
+        if constexpr (C == 2)
+          x = V { left[i], right[i] };
+        else
+          x = left[i];
+
+        biquad_stages<ONE_POLE> (coeffs, x, z1, z2, std::make_index_sequence<STAGES>());
+
+        if constexpr (C == 2)
+          {
+            left[i]  = x[0];
+            right[i] = x[1];
+          }
+        else
+          {
+            left[i] = x;
+          }
+      }
+    for (int s = 0; s < STAGES; s++)
+      {
+        if constexpr (C == 2)
           {
-            left[i]  = apply_biquad1p (left[i], sl);
-            if constexpr (C == 2)
-              right[i] = apply_biquad1p (right[i], sr);
+            state[s]->z1[0] = z1[s][0];
+            state[s]->z1[1] = z1[s][1];
+            state[s]->z2[0] = z2[s][0];
+            state[s]->z2[1] = z2[s][1];
           }
         else
           {
-            left[i] = apply_biquad (left[i], sl);
-            if constexpr (C == 2)
-              right[i] = apply_biquad (right[i], sr);
+            state[s]->z1[0] = z1[s];
+            state[s]->z2[0] = z2[s];
           }
       }
+  }
+  int
+  n_stages() const
+  {
+    return std::max (filter_order (filter_type_) / 2, 1);
+  }
+  /* coefficients and state for each stage of this filter, returns the number of stages */
+  int
+  get_stages (BiquadCoeffs *coeffs, BiquadState **state)
+  {
+    BiquadCoeffs c;
+    c.b0 = b0;
+    c.b1 = b1;
+    c.a1 = a1;
+    if (filter_order (filter_type_) > 1) /* one pole filters don't use b2 and a2 */
+      {
+        c.b2 = b2;
+        c.a2 = a2;
+      }
+    const int n = n_stages();
+    for (int s = 0; s < n; s++)
+      {
+        coeffs[s] = c;
+        state[s] = &b_state[s];
+      }
+    return n;
+  }
+  template<Type T, int STAGES, int C>
+  void
+  process_biquads (float *left, float *right, uint n_frames)
+  {
+    BiquadCoeffs coeffs[STAGES];
+    BiquadState *state[STAGES];
+    get_stages (coeffs, state);
 
-    b_state[S][0] = sl;
-    b_state[S][1] = sr;
+    process_stages<STAGES, C, filter_order (T) == 1> (coeffs, state, left, right, n_frames);
+  }
+  void
+  design (const CR& cr)
+  {
+    switch (filter_type_)
+    {
+      case Type::LPF_1P:  update_config<Type::LPF_1P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::HPF_1P:  update_config<Type::HPF_1P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::LPF_2P:  update_config<Type::LPF_2P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::HPF_2P:  update_config<Type::HPF_2P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::BPF_2P:  update_config<Type::BPF_2P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::BRF_2P:  update_config<Type::BRF_2P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::LPF_4P:  update_config<Type::LPF_4P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::HPF_4P:  update_config<Type::HPF_4P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::LPF_6P:  update_config<Type::LPF_6P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::HPF_6P:  update_config<Type::HPF_6P> (cr.cutoff, cr.resonance);
+                          break;
+      case Type::NONE:    ;
+      case Type::PEQ:     assert (false);
+    }
   }
   template<Type T, class CRFunc, int C> void
   process_internal (float *left, float *right, const CRFunc& cr_func, uint n_frames)
@@ -388,29 +573,15 @@ private:
             CR cr = cr_func (i);
             update_config<T> (cr.cutoff, cr.resonance);
 
-            config_count_down = 16;
+            config_count_down = CONFIG_INTERVAL;
           }
 
         uint todo = std::min (config_count_down, n_frames - i);
-        if constexpr (filter_order (T) == 1)
-          {
-            process_biquad<T, 0, C> (left + i, right + i, todo);
-          }
-        if constexpr (filter_order (T) == 2)
-          {
-            process_biquad<T, 0, C> (left + i, right + i, todo);
-          }
-        if constexpr (filter_order (T) == 4)
-          {
-            process_biquad<T, 0, C> (left + i, right + i, todo);
-            process_biquad<T, 1, C> (left + i, right + i, todo);
-          }
-        if constexpr (filter_order (T) == 6)
-          {
-            process_biquad<T, 0, C> (left + i, right + i, todo);
-            process_biquad<T, 1, C> (left + i, right + i, todo);
-            process_biquad<T, 2, C> (left + i, right + i, todo);
-          }
+        if constexpr (filter_order (T) <= 2)
+          process_biquads<T, 1, C> (left + i, right + i, todo);
+        else
+          process_biquads<T, filter_order (T) / 2, C> (left + i, right + i, todo);
+
         i += todo;
         config_count_down -= todo;
       }
@@ -428,17 +599,17 @@ private:
           {
             update_config_peq (freq, Q, gain_db);
 
-            config_count_down = 16;
+            config_count_down = CONFIG_INTERVAL;
           }
         uint todo = std::min (config_count_down, n_frames - i);
 
-        process_biquad<Type::PEQ, 0, C> (left + i, right + i, todo);
+        process_biquads<Type::PEQ, 1, C> (left + i, right + i, todo);
 
         i += todo;
         config_count_down -= todo;
       }
   }
-  template<int C, class CRFunc> void
+  template<int C, class CRFunc> LIQUIDSFZ_CPU_DISPATCH void
   process_type (float *left, float *right, const CRFunc& cr_func, uint n_frames)
   {
     switch (filter_type_)
@@ -471,15 +642,8 @@ public:
   void
   reset (Type filter_type, int sample_rate)
   {
-    for (int s = 0; s < 3; s++)
-      {
-        for (int c = 0; c < 2; c++)
-          {
-            reset_biquad (b_state[s][c]);
-            reset_biquad (b_state[s][c]);
-            reset_biquad (b_state[s][c]);
-          }
-      }
+    for (auto& state : b_state)
+      state = BiquadState();
     first = true;
     config_count_down = 0;
     filter_type_ = filter_type;
@@ -529,6 +693,206 @@ public:
   {
     process_peq<1> (left, nullptr, freq, Q, gain_db, n_frames);
   }
+  /* upper bound for the gain at any frequency, while the filter moves from its
+   * current configuration to the given resonance (or gain in dB for peq)
+   */
+  float
+  max_gain (float resonance) const
+  {
+    if (filter_type_ == Type::PEQ)
+      {
+        const float gain_db = first ? resonance : std::max (resonance, last_peq_gain);
+        return gain_db > 0 ? std::pow (10.f, gain_db / 20) : 1;
+      }
+    /* the one pole filters, bpf_2p and brf_2p never boost */
+    if (filter_order (filter_type_) < 2 || filter_type_ == Type::BPF_2P || filter_type_ == Type::BRF_2P)
+      return 1;
+
+    /* peak gain of each 2 pole lowpass/highpass stage, the bilinear transform keeps it */
+    const double Q = std::pow (10.0, (first ? resonance : std::max (resonance, last_resonance)) / 20);
+    const double stage_gain = Q > M_SQRT1_2 ? Q / std::sqrt (1 - 1 / (4 * Q * Q)) : 1;
+    return std::pow (stage_gain, filter_order (filter_type_) / 2);
+  }
+};
+
+/*
+ * Runs several filters in one pass over the block
+ *
+ * A voice can have two filters and a few eq bands. Instead of processing one
+ * filter after another, FilterCascade applies all biquad stages of all filters
+ * to a frame before moving on to the next frame. This avoids reading and
+ * writing the block once per filter, and allows the CPU to overlap the
+ * recursions of the individual stages.
+ *
+ * The filters are redesigned every Filter::CONFIG_INTERVAL frames, the
+ * positions where this happens can be queried with config_positions(), so the
+ * caller only needs to compute filter parameters for these positions.
+ */
+class FilterCascade
+{
+public:
+  static constexpr uint MAX_FILTERS = 5;
+  static constexpr uint MAX_STAGES = 9;
+private:
+  struct Entry
+  {
+    Filter           *filter = nullptr;
+    const Filter::CR *cr = nullptr; /* one entry per config position, nullptr for constant parameters */
+    Filter::CR        const_cr { 0, 0 };
+    float             peq_freq = 0;
+    float             peq_Q = 0;
+    float             peq_gain = 0;
+  };
+  std::array<Entry, MAX_FILTERS> entries_;
+  uint                           n_entries_ = 0;
+  uint                           config_count_down_ = 0;
+
+  template<int C>
+  void
+  run_stages (int n_stages, const Filter::BiquadCoeffs *coeffs, Filter::BiquadState *const *state, float *left, float *right, uint n_frames)
+  {
+    switch (n_stages)
+    {
+      case 1: Filter::process_stages<1, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 2: Filter::process_stages<2, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 3: Filter::process_stages<3, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 4: Filter::process_stages<4, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 5: Filter::process_stages<5, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 6: Filter::process_stages<6, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 7: Filter::process_stages<7, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 8: Filter::process_stages<8, C> (coeffs, state, left, right, n_frames);
+              break;
+      case 9: Filter::process_stages<9, C> (coeffs, state, left, right, n_frames);
+              break;
+      default: assert (false);
+    }
+  }
+  template<int C>
+  LIQUIDSFZ_CPU_DISPATCH void
+  process_channels (float *left, float *right, uint n_frames)
+  {
+    static_assert (C == 1 || C == 2);
+
+    Filter::BiquadCoeffs coeffs[MAX_STAGES];
+    Filter::BiquadState *state[MAX_STAGES];
+    int n_stages = 0;
+
+    uint i = 0;
+    uint config_index = 0;
+    while (i < n_frames)
+      {
+        const bool redesign = config_count_down_ == 0;
+        if (redesign)
+          {
+            for (uint e = 0; e < n_entries_; e++)
+              {
+                Entry& entry = entries_[e];
+                if (entry.filter->filter_type_ == Filter::Type::PEQ)
+                  entry.filter->update_config_peq (entry.peq_freq, entry.peq_Q, entry.peq_gain);
+                else
+                  entry.filter->design (entry.cr ? entry.cr[config_index] : entry.const_cr);
+              }
+            config_index++;
+            config_count_down_ = Filter::CONFIG_INTERVAL;
+          }
+        if (redesign || i == 0)
+          {
+            n_stages = 0;
+            for (uint e = 0; e < n_entries_; e++)
+              n_stages += entries_[e].filter->get_stages (coeffs + n_stages, state + n_stages);
+          }
+        uint todo = std::min (config_count_down_, n_frames - i);
+        run_stages<C> (n_stages, coeffs, state, left + i, right ? right + i : nullptr, todo);
+
+        i += todo;
+        config_count_down_ -= todo;
+      }
+  }
+public:
+  /* must be called whenever the filters are reset */
+  void
+  reset()
+  {
+    n_entries_ = 0;
+    config_count_down_ = 0;
+  }
+  /* store frame positions where the filters will be redesigned during the next n_frames in positions, returns number of positions */
+  uint
+  config_positions (uint n_frames, uint *positions) const
+  {
+    uint n = 0;
+    for (uint pos = config_count_down_; pos < n_frames; pos += Filter::CONFIG_INTERVAL)
+      positions[n++] = pos;
+    return n;
+  }
+  static constexpr uint
+  max_config_positions (uint n_frames)
+  {
+    return (n_frames + Filter::CONFIG_INTERVAL - 1) / Filter::CONFIG_INTERVAL;
+  }
+  /* remove all filters, needs to be done before adding the filters for each block */
+  void
+  clear()
+  {
+    n_entries_ = 0;
+  }
+  /* cr contains the filter parameters for each config position */
+  void
+  add_filter (Filter& filter, const Filter::CR *cr)
+  {
+    assert (n_entries_ < MAX_FILTERS && filter.filter_type_ != Filter::Type::PEQ);
+
+    Entry& entry = entries_[n_entries_++];
+    entry.filter = &filter;
+    entry.cr = cr;
+  }
+  /* filter with constant parameters */
+  void
+  add_filter (Filter& filter, const Filter::CR& cr)
+  {
+    assert (n_entries_ < MAX_FILTERS && filter.filter_type_ != Filter::Type::PEQ);
+
+    Entry& entry = entries_[n_entries_++];
+    entry.filter = &filter;
+    entry.cr = nullptr;
+    entry.const_cr = cr;
+  }
+  void
+  add_peq (Filter& filter, float freq, float Q, float gain_db)
+  {
+    assert (n_entries_ < MAX_FILTERS && filter.filter_type_ == Filter::Type::PEQ);
+
+    Entry& entry = entries_[n_entries_++];
+    entry.filter = &filter;
+    entry.cr = nullptr;
+    entry.peq_freq = freq;
+    entry.peq_Q = Q;
+    entry.peq_gain = gain_db;
+  }
+  bool
+  empty() const
+  {
+    return n_entries_ == 0;
+  }
+  void
+  process (float *left, float *right, uint n_frames)
+  {
+    if (n_entries_)
+      process_channels<2> (left, right, n_frames);
+  }
+  void
+  process_mono (float *left, uint n_frames)
+  {
+    if (n_entries_)
+      process_channels<1> (left, nullptr, n_frames);
+  }
 };
 
 }
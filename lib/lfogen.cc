@@ -18,14 +18,25 @@ LFOGen::LFOGen (Synth *synth,
 void
 LFOGen::start (const Region& region, int sample_rate)
 {
-  sample_rate_ = sample_rate;
-  first        = true;
+  first = true;
 
-  // smoothing should be the same for different sample rates
-  //  -> compute the smoothing factor from half-life time
-  const float smoothing_time    = 0.002;
-  const int   smoothing_samples = smoothing_time * sample_rate;
-  smoothing_factor_ = exp2f (-1.f / smoothing_samples);
+  if (sample_rate != sample_rate_)
+    {
+      sample_rate_ = sample_rate;
+
+      // smoothing should be the same for different sample rates
+      //  -> compute the smoothing factor from half-life time
+      const float smoothing_time    = 0.002;
+      const int   smoothing_samples = smoothing_time * sample_rate;
+      smoothing_factor_ = exp2f (-1.f / smoothing_samples);
+
+      float power = 1;
+      for (auto& p : smoothing_powers_)
+        {
+          power *= smoothing_factor_;
+          p = power;
+        }
+    }
 
   for (auto& output : outputs) // reset outputs
     output = Output();
@@ -37,7 +48,7 @@ LFOGen::start (const Region& region, int sample_rate)
     {
       lfos[i].params = &region.lfos[i];
       lfos[i].synth  = synth_;
-      lfos[i].wave = get_wave (region.lfos[i].wave);
+      lfos[i].wave = region.lfos[i].wave;
 
       double phase = region.lfos[i].phase;
       phase += synth_->get_cc_vec_value (voice_, region.lfos[i].phase_cc);
@@ -65,12 +76,49 @@ LFOGen::start (const Region& region, int sample_rate)
   update_ccs();
 }
 
+template<int WAVE>
+inline float
+LFOGen::eval_wave (LFO& lfo)
+{
+  if constexpr (WAVE == 0) // triangle
+    {
+      if (lfo.phase < 0.25f) return lfo.phase * 4;
+      if (lfo.phase < 0.75f) return 2 - lfo.phase * 4;
+      return -4 + lfo.phase * 4;
+    }
+  if constexpr (WAVE == 1) // sine
+    return sinf (lfo.phase * 2 * M_PI);
+  if constexpr (WAVE == 2) // pulse 75%
+    return lfo.phase < 0.75 ? 1 : 0;
+  if constexpr (WAVE == 3) // square
+    return lfo.phase < 0.5 ? 1 : 0;
+  if constexpr (WAVE == 4) // pulse 25%
+    return lfo.phase < 0.25 ? 1 : 0;
+  if constexpr (WAVE == 5) // pulse 12.5%
+    return lfo.phase < 0.125 ? 1 : 0;
+  if constexpr (WAVE == 6) // saw up
+    return lfo.phase * 2 - 1;
+  if constexpr (WAVE == 7) // saw down
+    return 1 - lfo.phase * 2;
+  if constexpr (WAVE == 12) // sample & hold
+    {
+      int sh_state = lfo.phase < 0.5;
+      if (lfo.last_sh_state != sh_state)
+        {
+          lfo.sh_value = lfo.synth->normalized_random_value() * 2 - 1;
+          lfo.last_sh_state = sh_state;
+        }
+      return lfo.sh_value;
+    }
+}
+
+template<int WAVE>
 inline void
 LFOGen::process_lfo (LFO& lfo, uint n_values)
 {
   if (!lfo.delay_len)
     {
-      lfo.value = lfo.wave->eval (lfo);
+      lfo.value = eval_wave<WAVE> (lfo);
 
       if (lfo.fade_pos < lfo.fade_len)
         lfo.value *= float (lfo.fade_pos) / lfo.fade_len;
@@ -118,95 +166,28 @@ LFOGen::write_output (uint start, uint n_values)
   if (!outputs[T].active)
     return;
 
-  float value      = post_function<T> (outputs[T].value);
-  float last_value = first ? value : outputs[T].last_value;
-  float a          = smoothing_factor_;
-  float b          = 1 - a;
-
-  float *out       = outputs[T].buffer + start;
+  /* the input of the smoothing filter is constant during one control block,
+   * so the filter output is given by
+   *
+   *   out[k] = value + (last_value - value) * smoothing_factor^(k + 1)
+   *
+   * which (unlike the recursive form) can be vectorized
+   */
+  const float value      = post_function<T> (outputs[T].value);
+  const float last_value = first ? value : outputs[T].last_value;
+  const float delta      = last_value - value;
+
+  float *out = outputs[T].buffer + start;
   for (uint k = 0; k < n_values; k++)
-    {
-      last_value = b * value + a * last_value;
-      out[k] = last_value;
-    }
-  outputs[T].last_value = last_value;
-}
+    out[k] = value + delta * smoothing_powers_[k];
 
-LFOGen::Wave *
-LFOGen::get_wave (int wave)
-{
-  static struct WaveTri : public Wave
-  {
-    float
-    eval (LFO& lfo) override
-    {
-      if (lfo.phase < 0.25f) return lfo.phase * 4;
-      if (lfo.phase < 0.75f) return 2 - lfo.phase * 4;
-      return -4 + lfo.phase * 4;
-    }
-  } wave_tri;
-  static struct WaveSin : public Wave
-  {
-    float eval (LFO& lfo) override { return sinf (lfo.phase * 2 * M_PI); };
-  } wave_sin;
-  static struct WavePulse75 : public Wave
-  {
-    float eval (LFO& lfo) override { return lfo.phase < 0.75 ? 1 : 0; };
-  } wave_pulse75;
-  static struct WaveSquare : public Wave
-  {
-    float eval (LFO& lfo) override { return lfo.phase < 0.5 ? 1 : 0; };
-  } wave_square;
-  static struct WavePulse25 : public Wave
-  {
-    float eval (LFO& lfo) override { return lfo.phase < 0.25 ? 1 : 0; };
-  } wave_pulse25;
-  static struct WavePulse125 : public Wave
-  {
-    float eval (LFO& lfo) override { return lfo.phase < 0.125 ? 1 : 0; };
-  } wave_pulse125;
-  static struct WaveSawUp : public Wave
-  {
-    float eval (LFO& lfo) override { return lfo.phase * 2 - 1; };
-  } wave_saw_up;
-  static struct WaveSawDown : public Wave
-  {
-    float eval (LFO& lfo) override { return 1 - lfo.phase * 2; };
-  } wave_saw_down;
-  static struct WaveSH : public Wave
-  {
-    float
-    eval (LFO& lfo) override
-    {
-      int sh_state = lfo.phase < 0.5;
-      if (lfo.last_sh_state != sh_state)
-        {
-          lfo.sh_value = lfo.synth->normalized_random_value() * 2 - 1;
-          lfo.last_sh_state = sh_state;
-        }
-      return lfo.sh_value;
-    };
-  } wave_sh;
-
-  switch (wave)
-  {
-    case 0: return &wave_tri;
-    case 1: return &wave_sin;
-    case 2: return &wave_pulse75;
-    case 3: return &wave_square;
-    case 4: return &wave_pulse25;
-    case 5: return &wave_pulse125;
-    case 6: return &wave_saw_up;
-    case 7: return &wave_saw_down;
-    case 12: return &wave_sh;
-    default: return nullptr;
-  }
+  outputs[T].last_value = out[n_values - 1];
 }
 
 bool
 LFOGen::supports_wave (int wave)
 {
-  return get_wave (wave) != nullptr;
+  return (wave >= 0 && wave <= 7) || wave == 12;
 }
 
 void
@@ -251,8 +232,7 @@ LFOGen::process (float *lfo_buffer, uint n_values)
   uint i = 0;
   while (i < n_values)
     {
-      constexpr uint block_size = 32;
-      uint todo = std::min (block_size, n_values - i);
+      uint todo = std::min (CONTROL_BLOCK, n_values - i);
 
       for (auto& output : outputs)
         output.value = 0;
@@ -263,7 +243,29 @@ LFOGen::process (float *lfo_buffer, uint n_values)
           lfo.next_freq_mod = 0;
         }
       for (auto& lfo : lfos)
-        process_lfo (lfo, todo);
+        {
+          switch (lfo.wave)
+            {
+              case 0:  process_lfo<0> (lfo, todo);
+                       break;
+              case 1:  process_lfo<1> (lfo, todo);
+                       break;
+              case 2:  process_lfo<2> (lfo, todo);
+                       break;
+              case 3:  process_lfo<3> (lfo, todo);
+                       break;
+              case 4:  process_lfo<4> (lfo, todo);
+                       break;
+              case 5:  process_lfo<5> (lfo, todo);
+                       break;
+              case 6:  process_lfo<6> (lfo, todo);
+                       break;
+              case 7:  process_lfo<7> (lfo, todo);
+                       break;
+              case 12: process_lfo<12> (lfo, todo);
+                       break;
+            }
+        }
 
       for (auto& ml : mod_links)
         *ml.dest += *ml.source * ml.factor;
@@ -20,12 +20,14 @@ public:
   static constexpr uint MAX_OUTPUTS = 3;
 
 private:
+  /* lfo values are computed once per control block, the outputs are smoothed per sample */
+  static constexpr uint CONTROL_BLOCK = 32;
+
   Synth *synth_ = nullptr;
   const Voice *voice_ = nullptr;
   int sample_rate_ = 0;
   float smoothing_factor_ = 0;
-
-  struct Wave;
+  std::array<float, CONTROL_BLOCK> smoothing_powers_; /* smoothing_factor_^(k + 1) */
 
   /* modulation links */
   struct ModLink
@@ -38,7 +40,7 @@ private:
     const LFOParams *params = nullptr;
     Synth *synth = nullptr;
     float phase = 0;
-    Wave *wave = nullptr;
+    int   wave = 0;
     float next_freq_mod = 0;
     float freq_mod = 0;
     float freq = 0;
@@ -61,18 +63,13 @@ private:
     float   last_value = 0;
     float   value      = 0;
   };
-  struct Wave
-  {
-    virtual float eval (LFO& lfo) = 0;
-  };
-  static Wave *get_wave (int wave);
-
   std::array<Output, MAX_OUTPUTS> outputs;
   bool first = false;
   std::vector<LFO> lfos;
   std::vector<ModLink> mod_links;
 
-  void process_lfo (LFO& lfo, uint n_values);
+  template<int WAVE> static float eval_wave (LFO& lfo);
+  template<int WAVE> void process_lfo (LFO& lfo, uint n_values);
 
   template<OutputType T>
   float
@@ -98,6 +95,11 @@ public:
   {
     return lfos.size() != 0;
   }
+  bool
+  has_output (OutputType type) const
+  {
+    return outputs[type].active;
+  }
   static bool supports_wave (int wave);
 };
 
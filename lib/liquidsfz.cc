@@ -68,6 +68,30 @@ Synth::preload_time() const
   return impl->synth.preload_time();
 }
 
+void
+Synth::set_preload_all (bool preload_all)
+{
+  impl->synth.set_preload_all (preload_all);
+}
+
+bool
+Synth::preload_all() const
+{
+  return impl->synth.preload_all();
+}
+
+void
+Synth::set_half_rate_samples (bool half_rate_samples)
+{
+  impl->synth.set_half_rate_samples (half_rate_samples);
+}
+
+bool
+Synth::half_rate_samples() const
+{
+  return impl->synth.half_rate_samples();
+}
+
 void
 Synth::set_sample_quality (int sample_quality)
 {
@@ -80,6 +104,30 @@ Synth::sample_quality()
   return impl->synth.sample_quality();
 }
 
+void
+Synth::set_adaptive_quality (bool adaptive_quality)
+{
+  impl->synth.set_adaptive_quality (adaptive_quality);
+}
+
+bool
+Synth::adaptive_quality() const
+{
+  return impl->synth.adaptive_quality();
+}
+
+void
+Synth::set_render_threads (uint n_threads)
+{
+  impl->synth.set_render_threads (n_threads);
+}
+
+uint
+Synth::render_threads() const
+{
+  return impl->synth.render_threads();
+}
+
 uint
 Synth::active_voice_count() const
 {
@@ -92,6 +140,12 @@ Synth::set_gain (float gain)
   impl->synth.set_gain (gain);
 }
 
+void
+Synth::set_random_seed (uint seed)
+{
+  impl->synth.set_random_seed (seed);
+}
+
 bool
 Synth::load (const std::string& filename)
 {
@@ -154,6 +154,9 @@ public:
    * \brief Set sample rate of the synthesizer
    *
    * @param sample_rate   new sample rate
+   *
+   * This should be called before @ref load(), because some decisions made
+   * while loading (see @ref set_half_rate_samples()) depend on the sample rate.
    */
   void set_sample_rate (uint sample_rate);
 
@@ -230,6 +233,74 @@ public:
    */
   uint preload_time() const;
 
+  /**
+   * \brief Preload complete samples
+   *
+   * @param preload_all  whether to load samples completely
+   *
+   * By default, only the start of each sample is loaded into memory (see @ref
+   * set_preload_time()), the rest is streamed from disk while notes are
+   * played. If enabled, samples are loaded completely (into one contiguous
+   * block of memory per sample) during @ref load(), which makes loading slower
+   * and needs more memory, but avoids all streaming overhead during playback.
+   * This is a good choice for instruments that fit into memory. Completely
+   * loaded samples are never unloaded from the sample cache while they are
+   * used.
+   *
+   * This function must be called before @ref load(). By default, samples are
+   * streamed.
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   */
+  void set_preload_all (bool preload_all);
+
+  /**
+   * \brief Get whether complete samples are preloaded
+   *
+   * See @ref set_preload_all().
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   *
+   * @returns whether complete samples are preloaded
+   */
+  bool preload_all() const;
+
+  /**
+   * \brief Enable half rate samples
+   *
+   * @param half_rate_samples  whether to use half rate copies of samples
+   *
+   * If enabled, @ref load() creates a copy of each sample at half the sample
+   * rate (lowpass filtered before decimation) for regions that can be played
+   * at least one octave above the original sample rate. Notes that start at
+   * such a replay speed are played from the half rate copy, which avoids
+   * aliasing and reduces the amount of sample data that needs to be read
+   * during playback, at the cost of additional memory for the sample cache.
+   * Regions with loop points at odd sample positions always use the original
+   * sample.
+   *
+   * This function must be called before @ref load(). Which regions get a half
+   * rate copy depends on the sample rate at load time, so @ref
+   * set_sample_rate() must also be called before @ref load(). If the sample
+   * rate is changed later, the sfz file needs to be loaded again, otherwise
+   * regions that need a half rate copy at the new sample rate may not have one.
+   * Half rate samples are disabled by default.
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   */
+  void set_half_rate_samples (bool half_rate_samples);
+
+  /**
+   * \brief Get whether half rate samples are enabled
+   *
+   * See @ref set_half_rate_samples().
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   *
+   * @returns whether half rate samples are enabled
+   */
+  bool half_rate_samples() const;
+
   /**
    * \brief Set sample quality
    *
@@ -237,14 +308,22 @@ public:
    *
    * Select interpolation quality (this is called sample_quality, because there
    * is an SFZ2 opcode called sample_quality that does just this). Currently
-   * liquidsfz implements 3 different levels for the interpolation quality.
+   * liquidsfz implements 4 different levels for the interpolation quality.
    *
    * 1. linear interpolation
    * 2. polynomial interpolation (hermite 6 point, 3rd order)
    * 3. high quality interpolation (hybrid 2x upsampling + 4 point polynomial interpolation)
+   * 4. very high quality interpolation (32 point windowed sinc, with a cutoff that
+   *    is lowered for high playback speeds, so transposing samples up doesn't alias)
+   *
+   * For quality 4, the cutoff follows the playback speed up to 4x (two octaves
+   * above the original pitch, including sample rate conversion). Notes played
+   * even faster alias. With @ref set_half_rate_samples() enabled, notes that
+   * start at 2x or more are played from the half rate copy, which extends
+   * the range to 8x.
    *
    * The default for this value is 3, which provides the best quality at a
-   * reasonable performance on modern systems.
+   * reasonable performance on modern systems. Quality 4 needs more CPU time.
    *
    * <em>This function is real-time safe and can be used from the audio thread.</em>
    */
@@ -259,6 +338,68 @@ public:
    */
   int sample_quality();
 
+  /**
+   * \brief Enable adaptive sample quality
+   *
+   * @param adaptive_quality whether to lower the quality for quiet voices
+   *
+   * If enabled, voices whose level (envelope and gain) is below -60 dB use
+   * linear interpolation instead of the interpolation selected by \ref
+   * set_sample_quality. This happens for instance during long release tails
+   * or for layers that are strongly attenuated. The interpolation artifacts of
+   * such voices are far below the audible range, so this saves CPU time
+   * without audible loss. A voice returns to the selected quality once its
+   * level rises above -54 dB again.
+   *
+   * Adaptive quality is disabled by default.
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   */
+  void set_adaptive_quality (bool adaptive_quality);
+
+  /**
+   * \brief Get whether adaptive sample quality is enabled
+   *
+   * See @ref set_adaptive_quality().
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   *
+   * @returns whether adaptive sample quality is enabled
+   */
+  bool adaptive_quality() const;
+
+  /**
+   * \brief Set number of threads used for rendering voices
+   *
+   * @param n_threads  number of render threads (including the thread that calls process)
+   *
+   * By default all voices are rendered by the thread calling \ref process.
+   * For large polyphonic instruments, using more than one thread can be used
+   * to distribute the voices over more than one CPU core. The extra worker
+   * threads are started by this function.
+   *
+   * The voices are split in one job per thread. The calling thread renders
+   * every job that no worker has started yet, so \ref process never waits for
+   * a worker to wake up and never blocks on a lock. The workers use the
+   * scheduling policy and priority (for instance realtime scheduling) of the
+   * thread calling \ref process, if allowed. Between two \ref process calls,
+   * idle workers busy wait for about 2 milliseconds (about one audio period),
+   * then they sleep on a semaphore.
+   *
+   * For a given number of threads the output is deterministic, but it is not
+   * bit identical to the output produced with a different number of threads.
+   */
+  void set_render_threads (uint n_threads);
+
+  /**
+   * \brief Get number of threads used for rendering voices
+   *
+   * <em>This function is real-time safe and can be used from the audio thread.</em>
+   *
+   * @returns number of render threads
+   */
+  uint render_threads() const;
+
   /**
    * \brief Get active voice count
    *
@@ -282,6 +423,18 @@ public:
    */
   void set_gain (float gain);
 
+  /**
+   * \brief Set random seed
+   *
+   * @param seed  seed for the random generator
+   *
+   * By default the random generator (used for random region selection,
+   * noise and sample & hold lfos, ...) is seeded from a nondeterministic
+   * source. Setting a fixed seed makes the output reproducible, for instance
+   * for offline rendering or tests.
+   */
+  void set_random_seed (uint seed);
+
   /**
    * \brief Load .sfz file including all samples
    *
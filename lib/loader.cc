@@ -155,6 +155,20 @@ Loader::search_xfcc (vector<XFCC>& xfcc_vec, int cc, int def)
   return xfcc_vec.emplace_back (xfcc);
 }
 
+CCRange&
+Loader::search_cc_range (vector<CCRange>& cc_ranges, int cc)
+{
+  for (auto& cc_range : cc_ranges)
+    {
+      if (cc_range.cc == cc)
+        return cc_range;
+    }
+  update_cc_info (cc);
+  CCRange cc_range;
+  cc_range.cc = cc;
+  return cc_ranges.emplace_back (cc_range);
+}
+
 CCInfo&
 Loader::update_cc_info (int cc)
 {
@@ -615,19 +629,13 @@ Loader::set_key_value (const string& key, const string& value)
     {
       int cc = sub_key;
       if (cc >= 0 && cc <= 127)
-        {
-          region.locc[cc] = convert_int (value);
-          update_cc_info (cc);
-        }
+        search_cc_range (region.cc_ranges, cc).lo = convert_int (value);
     }
   else if (split_sub_key (key, "hicc", sub_key))
     {
       int cc = sub_key;
       if (cc >= 0 && cc <= 127)
-        {
-          region.hicc[cc] = convert_int (value);
-          update_cc_info (cc);
-        }
+        search_cc_range (region.cc_ranges, cc).hi = convert_int (value);
     }
   else if (starts_with (key, "on_locc") || starts_with (key, "on_hicc"))
     region.trigger = Trigger::CC;
@@ -1298,6 +1306,63 @@ Loader::convert_lfo (Region& region, SimpleLFO& simple_lfo, SimpleLFO::Type type
   }
 }
 
+void
+Loader::init_cc_deps (Region& region)
+{
+  auto add_deps = [&region] (const CCParamVec& cc_vec, uint16_t dep)
+    {
+      for (const auto& entry : cc_vec)
+        if (entry.cc >= 0 && entry.cc <= 127)
+          region.cc_deps[entry.cc] |= dep;
+    };
+
+  region.cc_deps.fill (0);
+
+  add_deps (region.gain_cc, CC_DEP_VOLUME);
+  for (const auto& xfcc : region.xfin_ccs)
+    if (xfcc.cc >= 0 && xfcc.cc <= 127)
+      region.cc_deps[xfcc.cc] |= CC_DEP_VOLUME;
+  for (const auto& xfcc : region.xfout_ccs)
+    if (xfcc.cc >= 0 && xfcc.cc <= 127)
+      region.cc_deps[xfcc.cc] |= CC_DEP_VOLUME;
+
+  add_deps (region.pan_cc, CC_DEP_PAN);
+  add_deps (region.amplitude_cc, CC_DEP_AMPLITUDE);
+  if (region.volume_cc7)
+    region.cc_deps[7] |= CC_DEP_CC7_CC10;
+  if (region.pan_cc10)
+    region.cc_deps[10] |= CC_DEP_CC7_CC10;
+
+  add_deps (region.tune_cc, CC_DEP_TUNE);
+  add_deps (region.width_cc, CC_DEP_WIDTH);
+
+  add_deps (region.fil.cutoff_cc, CC_DEP_FIL_CUTOFF);
+  add_deps (region.fil.resonance_cc, CC_DEP_FIL_RESONANCE);
+  add_deps (region.fil2.cutoff_cc, CC_DEP_FIL2_CUTOFF);
+  add_deps (region.fil2.resonance_cc, CC_DEP_FIL2_RESONANCE);
+
+  for (size_t i = 0; i < region.eq_params.size() && i < MAX_EQ_BANDS; i++)
+    {
+      const auto& eq = region.eq_params[i];
+      if (eq.used)
+        {
+          add_deps (eq.freq_cc, CC_DEP_EQ1 << i);
+          add_deps (eq.gain_cc, CC_DEP_EQ1 << i);
+          add_deps (eq.bw_cc, CC_DEP_EQ1 << i);
+        }
+    }
+
+  for (const auto& lfo : region.lfos)
+    {
+      add_deps (lfo.pitch_cc, CC_DEP_LFO);
+      add_deps (lfo.volume_cc, CC_DEP_LFO);
+      add_deps (lfo.cutoff_cc, CC_DEP_LFO);
+      add_deps (lfo.freq_cc, CC_DEP_LFO);
+      for (const auto& lm : lfo.lfo_mods)
+        add_deps (lm.lfo_freq_cc, CC_DEP_LFO);
+    }
+}
+
 bool
 Loader::parse (const string& filename, SampleCache& sample_cache, const vector<Control::Define>& defines)
 {
@@ -1467,7 +1532,7 @@ Loader::parse (const string& filename, SampleCache& sample_cache, const vector<C
         {
           uint max_offset = region.offset + region.offset_random + lrint (get_cc_vec_max (region.offset_cc));
 
-          const auto load_result = sample_cache.load (region.sample, synth_->preload_time(), max_offset);
+          const auto load_result = sample_cache.load (region.sample, synth_->preload_time(), max_offset, 1, synth_->preload_all());
           region.cached_sample = load_result.sample;
 
           /* update progress info */
@@ -1519,6 +1584,23 @@ Loader::parse (const string& filename, SampleCache& sample_cache, const vector<C
                     synth_->warning ("%s: invalid loop range [%d, %d], sample_length=%d: loop_end must be < sample_length\n",
                                      region.sample.c_str(), region.loop_start, region.loop_end, sample_length);
                 }
+              if (synth_->half_rate_samples() && Voice::need_half_rate_sample (region, synth_->sample_rate()))
+                {
+                  const auto half_rate_result = sample_cache.load (region.sample, synth_->preload_time(), max_offset, 2, synth_->preload_all());
+                  region.half_rate_sample = half_rate_result.sample;
+                  region.half_rate_preload_info = half_rate_result.preload_info;
+                }
+              if ((region.loop_mode == LoopMode::SUSTAIN || region.loop_mode == LoopMode::CONTINUOUS) &&
+                  region.loop_start >= 0 && region.loop_end > region.loop_start)
+                {
+                  /* precompute the samples around the loop end, so voices don't need to wrap around per sample */
+                  const int seam_frames = SampleReader::LOOP_SEAM_FRAMES;
+                  region.loop_seam = sample_cache.load_loop_seam (region.cached_sample.get(), region.loop_start, region.loop_end,
+                                                                  region.end, seam_frames);
+                  if (region.half_rate_sample)
+                    region.half_rate_loop_seam = sample_cache.load_loop_seam (region.half_rate_sample.get(), region.loop_start / 2,
+                                                                              (region.loop_end + 1) / 2 - 1, region.end / 2, seam_frames);
+                }
             }
         }
       if (region.fil.cutoff < 0) /* filter defaults to lpf_2p, but only if cutoff was found */
@@ -1587,6 +1669,8 @@ Loader::parse (const string& filename, SampleCache& sample_cache, const vector<C
         lfo_mods += lfo.lfo_mods.size();
 
       limits.max_lfo_mods = std::max (limits.max_lfo_mods, lfo_mods);
+
+      init_cc_deps (region);
     }
 
   synth_->debug ("*** limits: max_lfos=%zd max_lfo_mods=%zd\n", limits.max_lfos, limits.max_lfo_mods);
@@ -132,6 +132,10 @@ public:
   std::vector<Entry>              entries_;
   uint                            id_;
   static inline std::atomic<uint> instance_counter;
+
+  /* assigned by Synth on load: per channel cache slot for the sum of the cc (<= 127) entries */
+  int                             cache_slot_ = -1;
+  bool                            has_ext_cc_ = false;
 };
 
 struct EGParam
@@ -152,6 +156,13 @@ struct XFCC
   int hi = -1;
 };
 
+struct CCRange
+{
+  int cc = -1;
+  int lo = 0;
+  int hi = 127;
+};
+
 struct CCInfo
 {
   int cc = -1;
@@ -248,12 +259,46 @@ struct CurveSection
   }
 };
 
+/* voice parameters that need to be recomputed if a cc changes (see Region::cc_deps) */
+enum CCDep : uint16_t
+{
+  CC_DEP_VOLUME         = 1 << 0,
+  CC_DEP_PAN            = 1 << 1,
+  CC_DEP_AMPLITUDE      = 1 << 2,
+  CC_DEP_CC7_CC10       = 1 << 3,
+  CC_DEP_TUNE           = 1 << 4,
+  CC_DEP_WIDTH          = 1 << 5,
+  CC_DEP_FIL_CUTOFF     = 1 << 6,
+  CC_DEP_FIL_RESONANCE  = 1 << 7,
+  CC_DEP_FIL2_CUTOFF    = 1 << 8,
+  CC_DEP_FIL2_RESONANCE = 1 << 9,
+  CC_DEP_EQ1            = 1 << 10, // EQ2 and EQ3 use the next two bits
+  CC_DEP_LFO            = 1 << 13
+};
+
 struct Limits
 {
   size_t max_lfos = 0;
   size_t max_lfo_mods = 0;
 };
 
+/* note independent part of the voice setup, precomputed per region and
+ * sample rate by Voice::init_start_template()
+ */
+struct VoiceStartTemplate
+{
+  uint  sample_rate = 0;
+
+  bool  const_volume_gain = false; // no gain_cc: volume gain only depends on region
+  float volume_gain = 0;
+
+  bool  const_pan_gain = false;    // no pan_cc: pan gains only depend on region
+  float pan_left_gain = 0;
+  float pan_right_gain = 0;
+
+  std::vector<float> eq_Q;         // for each eq band: Q, or -1 if freq/bw depend on ccs
+};
+
 struct Region
 {
   std::string sample;
@@ -262,6 +307,10 @@ struct Region
 
   SampleP              cached_sample;
   Sample::PreloadInfoP preload_info;
+  SampleP              half_rate_sample; // only loaded if needed (see Synth::set_half_rate_samples)
+  Sample::PreloadInfoP half_rate_preload_info;
+  std::vector<float>   loop_seam;        // sample data around the loop end, with wraparound
+  std::vector<float>   half_rate_loop_seam;
 
   bool switch_match = true;
 
@@ -284,8 +333,7 @@ struct Region
   Trigger trigger = Trigger::ATTACK;
   int seq_length = 1;
   int seq_position = 1;
-  std::vector<int> locc = std::vector<int> (128, 0);
-  std::vector<int> hicc = std::vector<int> (128, 127);
+  std::vector<CCRange> cc_ranges; /* locc/hicc: only ccs that have been set are stored */
   int sustain_cc = 64; /* sustain pedal CC */
 
   /* amp envelope generator */
@@ -376,10 +424,50 @@ struct Region
   bool volume_cc7 = false;
   bool pan_cc10 = false;
 
+  /* reverse cc index: for each cc a bitmask of CCDep values, so update_cc() can skip unaffected voices */
+  std::array<uint16_t, 128> cc_deps {};
+
   bool empty()
   {
     return sample == "" && generator == Generator::NONE;
   }
+  template<class Func> void
+  for_each_cc_vec (Func func)
+  {
+    for (auto *eg : { &ampeg_delay, &ampeg_attack, &ampeg_hold, &ampeg_decay, &ampeg_sustain, &ampeg_release,
+                      &fileg_depth, &fileg_delay, &fileg_attack, &fileg_hold, &fileg_decay, &fileg_sustain, &fileg_release })
+      func (eg->cc_vec);
+
+    for (auto *f : { &fil, &fil2 })
+      {
+        func (f->cutoff_cc);
+        func (f->resonance_cc);
+      }
+    for (auto& eq : eq_params)
+      {
+        func (eq.freq_cc);
+        func (eq.gain_cc);
+        func (eq.bw_cc);
+      }
+    for (auto& lfo : lfos)
+      {
+        for (auto *cc_vec : { &lfo.freq_cc, &lfo.delay_cc, &lfo.fade_cc, &lfo.phase_cc, &lfo.pitch_cc, &lfo.volume_cc, &lfo.cutoff_cc })
+          func (*cc_vec);
+        for (auto& lm : lfo.lfo_mods)
+          func (lm.lfo_freq_cc);
+      }
+    for (auto *cc_vec : { &pan_cc, &width_cc, &gain_cc, &amplitude_cc, &amp_veltrack_cc, &tune_cc, &delay_cc, &offset_cc })
+      func (*cc_vec);
+  }
+
+  VoiceStartTemplate start_template;
+
+  /* set by Synth on load: voice lists for off_by handling */
+  int off_by_list = -1; // voices of this region are in this list
+  int group_list = -1;  // starting this region stops the voices in this list
+
+  /* set by Synth on load: voices of this region are filtered by this shared filter bus */
+  int filter_bus = -1;
 
   /* playback state */
   int play_seq = 1;
@@ -445,6 +533,7 @@ class Loader
   bool parse_simple_lfo_param (Region& region, const std::string& type, SimpleLFO& lfo, const std::string& key, const std::string& value);
   bool parse_eq_param (Region& region, const std::string& key, const std::string& value);
   void convert_lfo (Region& region, SimpleLFO& simple_lfo, SimpleLFO::Type type);
+  void init_cc_deps (Region& region);
   float get_cc_vec_max (const CCParamVec& cc_param_vec);
   float get_cc_curve_max (const CCParamVec::Entry& entry);
 
@@ -555,6 +644,7 @@ public:
   }
   bool split_sub_key (const std::string& key, const std::string& start, int& sub_key);
   XFCC& search_xfcc (std::vector<XFCC>& xfcc_vec, int cc, int def);
+  CCRange& search_cc_range (std::vector<CCRange>& cc_ranges, int cc);
   CCInfo& update_cc_info (int cc);
   SetCC& update_set_cc (int cc, int value);
   KeyInfo& update_key_info (int key);
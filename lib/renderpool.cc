@@ -0,0 +1,151 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+#include "renderpool.hh"
+
+#include <chrono>
+
+using namespace LiquidSFZInternal;
+
+using std::chrono::steady_clock;
+
+RenderPool::~RenderPool()
+{
+  stop_workers();
+}
+
+void
+RenderPool::set_n_threads (uint n_threads)
+{
+  stop_workers();
+
+  quit_ = false;
+  for (uint i = 1; i < n_threads; i++)
+    {
+      Worker *worker = workers_.emplace_back (std::make_unique<Worker>()).get();
+      worker->thread = std::thread (&RenderPool::worker_loop, this, worker, generation_.load());
+    }
+}
+
+void
+RenderPool::stop_workers()
+{
+  quit_ = true;
+  for (auto& worker : workers_)
+    {
+      /* wait_for_generation() checks quit_ after setting sleeping */
+      if (worker->sleeping.exchange (false))
+        worker->wakeup_sem.post();
+      worker->thread.join();
+    }
+  workers_.clear();
+}
+
+bool
+RenderPool::wait_for_generation (Worker *worker, uint64_t generation)
+{
+  /* keep spinning for about one period, so that the next process() call is cheap */
+  const auto spin_end = steady_clock::now() + SPIN_TIME;
+  while (generation_.load (std::memory_order_acquire) == generation && !quit_)
+    {
+      if (steady_clock::now() > spin_end)
+        {
+          /* run_jobs() checks sleeping after incrementing generation_, so it either sees
+           * that we sleep and posts the semaphore, or we see the new generation here
+           */
+          worker->sleeping = true;
+          if (generation_.load() == generation && !quit_)
+            worker->wakeup_sem.wait();
+          else if (!worker->sleeping.exchange (false))
+            worker->wakeup_sem.wait(); // run_jobs() has already posted the semaphore
+        }
+      else
+        {
+          std::this_thread::yield();
+        }
+    }
+  return !quit_;
+}
+
+void
+RenderPool::update_worker_sched (Worker *worker)
+{
+  const int policy = sched_policy_.load (std::memory_order_relaxed);
+  const int priority = sched_priority_.load (std::memory_order_relaxed);
+  if (policy == worker->sched_policy && priority == worker->sched_priority)
+    return;
+
+  /* if this fails, we don't retry until the scheduling of the caller changes */
+  worker->sched_policy = policy;
+  worker->sched_priority = priority;
+
+  sched_param param = {};
+  param.sched_priority = priority;
+  if (pthread_setschedparam (pthread_self(), policy, &param) != 0)
+    {
+      param.sched_priority = 0;
+      pthread_setschedparam (pthread_self(), SCHED_OTHER, &param);
+    }
+}
+
+void
+RenderPool::worker_loop (Worker *worker, uint64_t generation)
+{
+  sched_param param;
+  if (pthread_getschedparam (pthread_self(), &worker->sched_policy, &param) == 0)
+    worker->sched_priority = param.sched_priority;
+
+  while (wait_for_generation (worker, generation))
+    {
+      /* if we were late, run_jobs() may have started another generation in the meantime */
+      generation = generation_.load (std::memory_order_acquire);
+
+      update_worker_sched (worker);
+      run_unclaimed_jobs();
+    }
+}
+
+void
+RenderPool::run_unclaimed_jobs()
+{
+  const uint n_jobs = n_threads();
+
+  uint job;
+  while ((job = next_job_.fetch_add (1, std::memory_order_acquire)) < n_jobs)
+    {
+      job_func_ (job_data_, job);
+      n_done_.fetch_add (1, std::memory_order_release);
+    }
+}
+
+void
+RenderPool::run_jobs()
+{
+  if (workers_.empty())
+    {
+      job_func_ (job_data_, 0);
+      return;
+    }
+  int policy;
+  sched_param param;
+  if (pthread_getschedparam (pthread_self(), &policy, &param) == 0)
+    {
+      sched_policy_.store (policy, std::memory_order_relaxed);
+      sched_priority_.store (param.sched_priority, std::memory_order_relaxed);
+    }
+
+  /* all jobs of the previous run() are done, so no worker accesses the job data */
+  n_done_.store (0, std::memory_order_relaxed);
+  next_job_.store (0, std::memory_order_release);
+  generation_++;
+
+  for (auto& worker : workers_)
+    if (worker->sleeping.load() && worker->sleeping.exchange (false))
+      worker->wakeup_sem.post();
+
+  /* render all jobs that no worker has started, so we never wait for a worker to wake up */
+  run_unclaimed_jobs();
+
+  /* usually the workers finish at about the same time as we do */
+  while (n_done_.load (std::memory_order_acquire) < n_threads())
+    std::this_thread::yield();
+}
@@ -0,0 +1,147 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "utils.hh"
+
+#if LIQUIDSFZ_OS_MACOS
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+namespace LiquidSFZInternal
+{
+
+/* counting semaphore, post() doesn't take locks or block, so the audio thread can use it */
+class Semaphore
+{
+#if LIQUIDSFZ_OS_MACOS
+  dispatch_semaphore_t sem_;
+public:
+  Semaphore()
+  {
+    sem_ = dispatch_semaphore_create (0);
+  }
+  ~Semaphore()
+  {
+    dispatch_release (sem_);
+  }
+  void
+  post()
+  {
+    dispatch_semaphore_signal (sem_);
+  }
+  void
+  wait()
+  {
+    dispatch_semaphore_wait (sem_, DISPATCH_TIME_FOREVER);
+  }
+#else
+  sem_t sem_;
+public:
+  Semaphore()
+  {
+    sem_init (&sem_, 0, 0);
+  }
+  ~Semaphore()
+  {
+    sem_destroy (&sem_);
+  }
+  void
+  post()
+  {
+    sem_post (&sem_);
+  }
+  void
+  wait()
+  {
+    while (sem_wait (&sem_) != 0 && errno == EINTR)
+      ;
+  }
+#endif
+  Semaphore (const Semaphore&) = delete;
+  Semaphore& operator= (const Semaphore&) = delete;
+};
+
+/*
+ * Pool of worker threads for rendering audio
+ *
+ * run() executes n_threads() jobs. Each job index is handled exactly once,
+ * so the caller can assign work to jobs in a deterministic way, but jobs are
+ * not bound to threads: the workers and the thread calling run() claim the
+ * next unstarted job from an atomic counter. So run() never waits for a
+ * worker to wake up, it renders all jobs that no worker has claimed itself,
+ * and only spins while claimed jobs are still being rendered.
+ *
+ * Waiting workers spin for SPIN_TIME, which is about one audio period, and
+ * then park on a semaphore. run() doesn't allocate memory, take locks or
+ * block, waking a parked worker only posts its semaphore.
+ *
+ * The workers use the scheduling policy and priority of the thread calling
+ * run(), which is usually a realtime audio thread. If that is not allowed,
+ * they fall back to normal scheduling.
+ */
+class RenderPool
+{
+  struct Worker
+  {
+    std::thread       thread;
+    Semaphore         wakeup_sem;
+    std::atomic<bool> sleeping = false;
+    int               sched_policy = SCHED_OTHER; // scheduling of the worker thread
+    int               sched_priority = 0;
+  };
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::atomic<uint64_t>    generation_ = 0;
+  std::atomic<uint>        next_job_ = 0;
+  std::atomic<uint>        n_done_ = 0;
+  std::atomic<bool>        quit_ = false;
+
+  /* scheduling of the thread calling run() */
+  std::atomic<int>         sched_policy_ = SCHED_OTHER;
+  std::atomic<int>         sched_priority_ = 0;
+
+  static constexpr auto    SPIN_TIME = std::chrono::milliseconds (2);
+
+  void (*job_func_) (void *data, uint job) = nullptr;
+  void                    *job_data_ = nullptr;
+
+  void worker_loop (Worker *worker, uint64_t generation);
+  bool wait_for_generation (Worker *worker, uint64_t generation);
+  void update_worker_sched (Worker *worker);
+  void run_unclaimed_jobs();
+  void stop_workers();
+  void run_jobs();
+public:
+  RenderPool() = default;
+  ~RenderPool();
+
+  void set_n_threads (uint n_threads);
+  uint
+  n_threads() const
+  {
+    return workers_.size() + 1;
+  }
+
+  /* runs func (job) for job = 0 .. n_threads() - 1 on any thread of the pool and waits for all jobs to complete */
+  template<class Func> void
+  run (Func& func)
+  {
+    job_func_ = [] (void *data, uint job) { (*static_cast<Func *> (data)) (job); };
+    job_data_ = &func;
+    run_jobs();
+  }
+};
+
+}
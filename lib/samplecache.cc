@@ -1,6 +1,7 @@
 // This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
 
 #include "samplecache.hh"
+#include "upsample.hh"
 
 using std::max;
 using std::min;
@@ -15,7 +16,11 @@ namespace LiquidSFZInternal {
 bool
 Sample::PlayHandle::lookup (sample_count_t pos)
 {
-  int buffer_index = (pos + SampleBuffer::frames_overlap * sample_->channels_) / (SampleBuffer::frames_per_buffer * sample_->channels_);
+  int buffer_index;
+  if (sample_->preload_all_) /* only one buffer, which starts frames_overlap frames before the sample */
+    buffer_index = pos >= -SampleBuffer::frames_overlap * sample_->channels_ ? 0 : -1;
+  else
+    buffer_index = (pos + SampleBuffer::frames_overlap * sample_->channels_) / (SampleBuffer::frames_per_buffer * sample_->channels_);
   if (buffer_index >= 0 && buffer_index < int (sample_->buffers_.size()))
     {
       sample_->update_max_buffer_index (buffer_index);
@@ -81,7 +86,7 @@ Sample::add_preload (uint time_ms, uint offset)
 }
 
 bool
-Sample::preload (const string& filename)
+Sample::preload (const string& filename, uint decimation, bool preload_all)
 {
   SF_INFO sfinfo = { 0, };
   auto sf = sample_cache_->sf_pool().open (filename, &sfinfo);
@@ -119,7 +124,9 @@ Sample::preload (const string& filename)
 
   sample_rate_ = sfinfo.samplerate;
   channels_ = sfinfo.channels;
-  n_samples_ = sfinfo.frames * sfinfo.channels;
+  decimation_ = decimation;
+  preload_all_ = preload_all;
+  n_samples_ = (sfinfo.frames + decimation - 1) / decimation * sfinfo.channels;
   filename_ = filename;
 
   /* if we use mmap, we keep the file open */
@@ -132,6 +139,13 @@ Sample::preload (const string& filename)
 
   update_preload_and_read_ahead();
 
+  if (preload_all_)
+    {
+      buffers_.resize (1);
+      load_all (sf.get());
+      return true;
+    }
+
   size_t n_buffers = 0;
   while (pos < frames)
     {
@@ -154,7 +168,7 @@ Sample::update_preload_and_read_ahead()
 
   auto offset_to_ms = [&] (sample_count_t offset) -> uint
     {
-      return std::clamp<sample_count_t> (offset, 0, frames) * 1000. / sample_rate_;
+      return std::clamp<sample_count_t> (offset / decimation_, 0, frames) * 1000. * decimation_ / sample_rate_;
     };
   uint preload_time_ms = 0;
   uint read_ahead_time_ms = 0;
@@ -173,7 +187,7 @@ Sample::update_preload_and_read_ahead()
         }
     }
 
-  double buffer_size_ms = 1000.0 * SampleBuffer::frames_per_buffer / sample_rate_;
+  double buffer_size_ms = 1000.0 * SampleBuffer::frames_per_buffer * decimation_ / sample_rate_;
   n_preload_buffers_ = std::max<size_t> (preload_time_ms / buffer_size_ms + 1, 1);
   n_read_ahead_buffers_ = std::max<size_t> (read_ahead_time_ms / buffer_size_ms + 1, 1);
 
@@ -191,6 +205,83 @@ Sample::update_preload_and_read_ahead()
     }
 }
 
+sf_count_t
+Sample::read_decimated_frames (SFPool::Entry *sf, sf_count_t pos, float *buffer, sf_count_t frame_count)
+{
+  /* the filter needs this many file frames before and after the frames it decimates */
+  constexpr sf_count_t margin = 2 * UPSAMPLE_TAPS - 1;
+
+  assert (decimation_ == 2);
+
+  /* input frame 0 is file frame (2 * pos - margin), frames before the start of the file are zero */
+  const sf_count_t n_input = 2 * frame_count + 2 * margin;
+  const sf_count_t skip = std::max<sf_count_t> (margin - 2 * pos, 0);
+
+  vector<float> input (n_input * channels_);
+  sf_count_t frames_read = sf->seek_read_frames (2 * pos - margin + skip, &input[skip * channels_], n_input - skip);
+  if (frames_read < 0)
+    frames_read = 0;
+
+  downsample_2x (&input[margin * channels_], buffer, frame_count, channels_);
+
+  /* number of output frames before the end of the file */
+  const sf_count_t input_end = skip + frames_read - margin;
+  return std::clamp<sf_count_t> ((input_end + 1) / 2, 0, frame_count);
+}
+
+/*
+ * returns frames (loop_end + 1 - seam_frames) .. (loop_end + seam_frames) of
+ * the looped sample, that is: the end of the loop followed by the start of the
+ * loop, repeated as often as necessary for short loops
+ */
+vector<float>
+Sample::read_loop_seam (int loop_start, int loop_end, int end, int seam_frames)
+{
+  SF_INFO sfinfo;
+  auto sf = SFPool::use_mmap ? mmap_sf_ : sample_cache_->sf_pool().open (filename_, &sfinfo);
+  if (!sf->sndfile)
+    return {};
+
+  auto read_frames = [&] (int pos, int n_frames)
+    {
+      vector<float> frames (n_frames * channels_);
+      sf_count_t frames_read;
+      if (decimation_ == 1)
+        frames_read = sf->seek_read_frames (pos, frames.data(), n_frames);
+      else
+        frames_read = read_decimated_frames (sf.get(), pos, frames.data(), n_frames);
+
+      frames_read = std::clamp<sf_count_t> (frames_read, 0, n_frames);
+      std::fill (frames.begin() + frames_read * channels_, frames.end(), 0);
+      return frames;
+    };
+
+  const int loop_len = loop_end - loop_start + 1;
+  const int n = min (loop_len, seam_frames);
+  const auto head = read_frames (loop_start, n);
+  const auto tail = read_frames (loop_end + 1 - n, n);
+
+  vector<float> seam (2 * seam_frames * channels_);
+  for (int i = 0; i < 2 * seam_frames; i++)
+    {
+      int x = loop_end + 1 - seam_frames + i;
+      while (x < loop_start)
+        x += loop_len;
+      while (x > loop_end)
+        x -= loop_len;
+
+      for (uint c = 0; c < channels_; c++)
+        {
+          float value = 0;
+          if (x <= end) // like SampleReader: no sample data after the region end
+            value = x < loop_start + n ? head[(x - loop_start) * channels_ + c] : tail[(x - (loop_end + 1 - n)) * channels_ + c];
+
+          seam[i * channels_ + c] = value;
+        }
+    }
+  return seam;
+}
+
 void
 Sample::load_buffer (SFPool::Entry *sf, size_t b)
 {
@@ -202,7 +293,11 @@ Sample::load_buffer (SFPool::Entry *sf, size_t b)
 
       float     *sample_ptr = data->samples() + SampleBuffer::frames_overlap * channels_;
 
-      sf_count_t frames_read = sf->seek_read_frames (b * SampleBuffer::frames_per_buffer, sample_ptr, SampleBuffer::frames_per_buffer);
+      sf_count_t frames_read;
+      if (decimation_ == 1)
+        frames_read = sf->seek_read_frames (b * SampleBuffer::frames_per_buffer, sample_ptr, SampleBuffer::frames_per_buffer);
+      else
+        frames_read = read_decimated_frames (sf, b * SampleBuffer::frames_per_buffer, sample_ptr, SampleBuffer::frames_per_buffer);
       if (frames_read != SampleBuffer::frames_per_buffer)
         {
           if (frames_read < 0)
@@ -233,6 +328,34 @@ Sample::load_buffer (SFPool::Entry *sf, size_t b)
     }
 }
 
+void
+Sample::load_all (SFPool::Entry *sf)
+{
+  /* one contiguous buffer for the whole sample, with frames_overlap zero frames at both ends */
+  const sf_count_t frames = n_samples_ / channels_;
+  const sf_count_t padding = SampleBuffer::frames_overlap;
+
+  auto data = new SampleBuffer::Data (sample_cache_, (frames + 2 * padding) * channels_);
+  data->start_n_values = -padding * channels_;
+
+  float *sample_ptr = data->samples() + padding * channels_;
+
+  sf_count_t frames_read;
+  if (decimation_ == 1)
+    frames_read = sf->seek_read_frames (0, sample_ptr, frames);
+  else
+    frames_read = read_decimated_frames (sf, 0, sample_ptr, frames);
+
+  frames_read = std::clamp<sf_count_t> (frames_read, 0, frames);
+
+  zero_float_block (padding * channels_, data->samples());
+  zero_float_block ((frames - frames_read + padding) * channels_, sample_ptr + frames_read * channels_);
+
+  buffers_[0].data = data;
+
+  last_update_ = sample_cache_->next_update_counter();
+}
+
 void
 Sample::load()
 {
@@ -364,7 +487,7 @@ SampleCache::trigger_load_and_wait()
 }
 
 SampleCache::LoadResult
-SampleCache::load (const string& filename, uint preload_time_ms, uint offset)
+SampleCache::load (const string& filename, uint preload_time_ms, uint offset, uint decimation, bool preload_all)
 {
   std::lock_guard lg (mutex_);
 
@@ -372,7 +495,8 @@ SampleCache::load (const string& filename, uint preload_time_ms, uint offset)
   for (const auto& weak : cache_)
     {
       SampleP cached_sample = weak.lock();
-      if (cached_sample && cached_sample->filename() == filename) /* already in cache? */
+      if (cached_sample && cached_sample->filename() == filename && cached_sample->decimation() == decimation &&
+          cached_sample->preload_all() == preload_all) /* already in cache? */
         {
           result.sample = cached_sample;
           result.preload_info = cached_sample->add_preload (preload_time_ms, offset);
@@ -384,7 +508,7 @@ SampleCache::load (const string& filename, uint preload_time_ms, uint offset)
   auto sample = std::make_shared<Sample> (this);
   auto preload_info = sample->add_preload (preload_time_ms, offset);
 
-  if (sample->preload (filename))
+  if (sample->preload (filename, decimation, preload_all))
     {
       result.sample = sample;
       result.preload_info = preload_info;
@@ -395,6 +519,14 @@ SampleCache::load (const string& filename, uint preload_time_ms, uint offset)
   return result;
 }
 
+vector<float>
+SampleCache::load_loop_seam (Sample *sample, int loop_start, int loop_end, int end, int seam_frames)
+{
+  std::lock_guard lg (mutex_);
+
+  return sample->read_loop_seam (loop_start, loop_end, end, seam_frames);
+}
+
 void
 SampleCache::cleanup_post_load()
 {
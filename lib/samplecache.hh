@@ -167,6 +167,8 @@ class Sample {
 
   uint                        sample_rate_;
   uint                        channels_;
+  uint                        decimation_ = 1;
+  bool                        preload_all_ = false;
   size_t                      n_samples_ = 0;
 
   std::atomic<int>            max_buffer_index_ = 0;
@@ -212,6 +214,18 @@ public:
   {
     return sample_rate_;
   }
+  /* 1 for the original sample data, 2 for a half rate copy (sample_rate() is always the rate of the file) */
+  uint
+  decimation() const
+  {
+    return decimation_;
+  }
+  /* true if the sample data is kept in memory completely (in one buffer) instead of streaming it */
+  bool
+  preload_all() const
+  {
+    return preload_all_;
+  }
   bool
   loop() const
   {
@@ -323,6 +337,20 @@ public:
         }
       return handle_lookup_fail (n);
     }
+    LIQUIDSFZ_ALWAYS_INLINE
+    const float *
+    get_span (sample_count_t pos, sample_count_t n)
+    {
+      /* like get_n(), but only succeeds if the samples are in the current
+       * buffer, so the state is never changed; if nullptr is returned, the
+       * caller is expected to fall back to get_n()
+       */
+      sample_count_t offset = pos - start_pos_;
+      if (samples_ && offset >= 0 && pos + n < end_pos_)
+        return samples_ + offset;
+
+      return nullptr;
+    }
     float
     get (sample_count_t pos)
     {
@@ -355,8 +383,11 @@ public:
   typedef std::shared_ptr<PreloadInfo> PreloadInfoP;
 
   PreloadInfoP add_preload (uint time_ms, uint offset);
-  bool preload (const std::string& filename);
+  bool preload (const std::string& filename, uint decimation, bool preload_all);
   void load_buffer (SFPool::Entry *sf, size_t b);
+  void load_all (SFPool::Entry *sf);
+  sf_count_t read_decimated_frames (SFPool::Entry *sf, sf_count_t pos, float *buffer, sf_count_t frame_count);
+  std::vector<float> read_loop_seam (int loop_start, int loop_end, int end, int seam_frames);
   void load();
   void unload();
   void free_unused_data();
@@ -400,7 +431,8 @@ public:
     SampleP sample;
     Sample::PreloadInfoP preload_info;
   };
-  LoadResult load (const std::string& filename, uint preload_time_ms, uint offset);
+  LoadResult load (const std::string& filename, uint preload_time_ms, uint offset, uint decimation = 1, bool preload_all = false);
+  std::vector<float> load_loop_seam (Sample *sample, int loop_start, int loop_end, int end, int seam_frames);
   void cleanup_post_load();
   void trigger_load_and_wait();
 
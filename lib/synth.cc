@@ -6,6 +6,9 @@
 
 #include <stdarg.h>
 
+#include <map>
+#include <tuple>
+
 using LiquidSFZ::Log;
 
 using std::string;
@@ -27,8 +30,35 @@ Synth::process_audio (float **outputs, uint n_frames, uint offset)
         outputs[1] + offset + i
       };
 
+      const bool parallel = render_pool_.n_threads() > 1 && active_voices_.size() >= render_pool_.n_threads() * MIN_VOICES_PER_THREAD;
+      const uint n_jobs = parallel ? render_pool_.n_threads() : 1;
+
+      /* clear the bus buffers that the voices will be mixed into */
       for (Voice *voice : active_voices_)
-        voice->process (outputs_offset, todo);
+        if (voice->region_->filter_bus >= 0)
+          filter_buses_[voice->region_->filter_bus].used = true;
+      for (uint b = 0; b < filter_buses_.size(); b++)
+        {
+          if (filter_buses_[b].used)
+            {
+              for (uint job = 0; job < n_jobs; job++)
+                {
+                  zero_float_block (todo, filter_bus_buffer (job, b));
+                  zero_float_block (todo, filter_bus_buffer (job, b) + MAX_BLOCK_SIZE);
+                }
+            }
+        }
+
+      if (parallel)
+        {
+          process_voices_parallel (outputs_offset, todo);
+        }
+      else
+        {
+          for (Voice *voice : active_voices_)
+            process_voice (voice, outputs_offset, todo, 0);
+        }
+      process_filter_buses (outputs_offset, todo, n_jobs);
 
       update_idle_voices();
       i += todo;
@@ -36,6 +66,145 @@ Synth::process_audio (float **outputs, uint n_frames, uint offset)
   global_frame_count += n_frames;
 }
 
+/* noise generators and sample & hold lfos use the synth random generator while rendering */
+static bool
+uses_random_gen (const Region& region)
+{
+  if (region.generator == Generator::NOISE)
+    return true;
+  for (const auto& lfo : region.lfos)
+    if (lfo.wave == 12)
+      return true;
+  return false;
+}
+
+void
+Synth::process_voices_parallel (float **outputs, uint n_frames)
+{
+  /* voices that use our random generator can't be rendered in a worker thread */
+  parallel_voices_.clear();
+  for (Voice *voice : active_voices_)
+    if (!uses_random_gen (*voice->region_))
+      parallel_voices_.push_back (voice);
+
+  /* each job renders a fixed range of voices into its own buffers, so the result doesn't
+   * depend on which thread claims the job (the render pool lets any idle thread do it)
+   */
+  const uint n_jobs = render_pool_.n_threads();
+  auto render_job = [&] (uint job)
+    {
+      float *job_outputs[2] = { outputs[0], outputs[1] };
+      if (job > 0)
+        {
+          job_outputs[0] = &render_buffers_[(job - 1) * 2 * MAX_BLOCK_SIZE];
+          job_outputs[1] = job_outputs[0] + MAX_BLOCK_SIZE;
+
+          zero_float_block (n_frames, job_outputs[0]);
+          zero_float_block (n_frames, job_outputs[1]);
+        }
+      const size_t start = parallel_voices_.size() * job / n_jobs;
+      const size_t end = parallel_voices_.size() * (job + 1) / n_jobs;
+      for (size_t v = start; v < end; v++)
+        process_voice (parallel_voices_[v], job_outputs, n_frames, job);
+    };
+  render_pool_.run (render_job);
+
+  for (uint job = 1; job < n_jobs; job++)
+    {
+      const float *left = &render_buffers_[(job - 1) * 2 * MAX_BLOCK_SIZE];
+      const float *right = left + MAX_BLOCK_SIZE;
+      float *out_left = outputs[0];
+      float *out_right = outputs[1];
+
+      for (uint i = 0; i < n_frames; i++)
+        {
+          out_left[i] += left[i];
+          out_right[i] += right[i];
+        }
+    }
+  for (Voice *voice : active_voices_)
+    if (uses_random_gen (*voice->region_))
+      process_voice (voice, outputs, n_frames, 0);
+}
+
+void
+Synth::process_voice (Voice *voice, float **outputs, uint n_frames, uint job)
+{
+  const int bus = voice->region_->filter_bus;
+  if (bus >= 0)
+    {
+      float *bus_outputs[2] = { filter_bus_buffer (job, bus), filter_bus_buffer (job, bus) + MAX_BLOCK_SIZE };
+
+      voice->process (bus_outputs, n_frames);
+    }
+  else
+    {
+      voice->process (outputs, n_frames);
+    }
+}
+
+void
+Synth::process_filter_buses (float **outputs, uint n_frames, uint n_jobs)
+{
+  for (uint b = 0; b < filter_buses_.size(); b++)
+    {
+      FilterBus& bus = filter_buses_[b];
+      if (!bus.used && !bus.active)
+        continue;
+
+      if (!bus.used && !bus.ring_out)
+        {
+          /* the voices were choked, with per voice filters the filter output would end with the voice */
+          reset_filter_bus (b);
+          continue;
+        }
+
+      float *left = filter_bus_buffer (0, b);
+      float *right = left + MAX_BLOCK_SIZE;
+      if (bus.used)
+        {
+          for (uint job = 1; job < n_jobs; job++)
+            {
+              const float *job_left = filter_bus_buffer (job, b);
+              const float *job_right = job_left + MAX_BLOCK_SIZE;
+              for (uint i = 0; i < n_frames; i++)
+                {
+                  left[i] += job_left[i];
+                  right[i] += job_right[i];
+                }
+            }
+        }
+      else
+        {
+          /* no voices left: let the filter ring out */
+          zero_float_block (n_frames, left);
+          zero_float_block (n_frames, right);
+        }
+      bus.cascade.process (left, right, n_frames);
+
+      float gain[MAX_BLOCK_SIZE];
+      bus.gain.process (gain, n_frames);
+
+      float peak = 0;
+      for (uint i = 0; i < n_frames; i++)
+        {
+          outputs[0][i] += left[i] * gain[i];
+          outputs[1][i] += right[i] * gain[i];
+          peak = std::max (peak, std::max (std::abs (left[i]), std::abs (right[i])));
+        }
+      if (bus.used)
+        {
+          bus.used = false;
+          bus.active = true;
+        }
+      else if (peak < 1e-7) // -140 dB
+        {
+          /* filter output has decayed, stop processing the bus until new voices are mixed into it */
+          reset_filter_bus (b);
+        }
+    }
+}
+
 void
 Synth::sort_events_stable()
 {
@@ -109,6 +278,213 @@ Synth::process (float **outputs, uint n_frames)
   process_audio (outputs, n_frames - offset, offset);
 }
 
+void
+Synth::build_region_index()
+{
+  for (auto *index : { &attack_regions_, &release_regions_, &switch_regions_ })
+    for (auto& key_regions : *index)
+      key_regions.clear();
+
+  for (auto& region : regions_)
+    {
+      /* regions with other triggers (like Trigger::CC) are never started by trigger_regions() */
+      if (region.trigger == Trigger::ATTACK || region.trigger == Trigger::RELEASE)
+        {
+          auto& index = region.trigger == Trigger::ATTACK ? attack_regions_ : release_regions_;
+
+          for (int key = std::max (region.lokey, 0); key <= std::min (region.hikey, 127); key++)
+            index[key].push_back (&region);
+        }
+      for (int key = std::max (region.sw_lokey, 0); key <= std::min (region.sw_hikey, 127); key++)
+        switch_regions_[key].push_back (&region);
+    }
+
+  /* one voice list for each off_by value, which contains the voices that can be stopped by a group */
+  std::map<uint, int> off_by_lists;
+  for (auto& region : regions_)
+    {
+      region.off_by_list = -1;
+      if (region.off_by)
+        {
+          auto it = off_by_lists.find (region.off_by);
+          if (it == off_by_lists.end())
+            it = off_by_lists.emplace (region.off_by, off_by_lists.size()).first;
+          region.off_by_list = it->second;
+        }
+    }
+  for (auto& region : regions_)
+    {
+      region.group_list = -1;
+      if (region.group)
+        {
+          auto it = off_by_lists.find (region.group);
+          if (it != off_by_lists.end())
+            region.group_list = it->second;
+        }
+    }
+  off_by_voices_.clear();
+  off_by_voices_.resize (off_by_lists.size());
+}
+
+void
+Synth::build_cc_vec_cache()
+{
+  for (auto& slots : cc_vec_cache_slots_)
+    slots.clear();
+
+  /* CCParamVecs with identical cc entries (typically inherited from <group> or
+   * <global>) share one cache slot, so their sum is only computed once
+   */
+  std::map<vector<std::tuple<int, int, float>>, int> slot_map;
+  for (auto& region : regions_)
+    {
+      region.for_each_cc_vec ([&] (CCParamVec& cc_vec)
+        {
+          vector<std::tuple<int, int, float>> key;
+
+          cc_vec.has_ext_cc_ = false;
+          for (const auto& entry : cc_vec)
+            {
+              if (entry.cc <= 127)
+                key.emplace_back (entry.cc, entry.curvecc, entry.value);
+              else
+                cc_vec.has_ext_cc_ = true;
+            }
+          if (key.empty())
+            {
+              cc_vec.cache_slot_ = -1;
+              return;
+            }
+          auto it = slot_map.find (key);
+          if (it != slot_map.end())
+            {
+              cc_vec.cache_slot_ = it->second;
+              return;
+            }
+          const int slot = slot_map.size();
+          slot_map[key] = slot;
+          cc_vec.cache_slot_ = slot;
+
+          for (const auto& entry : cc_vec)
+            {
+              if (entry.cc >= 0 && entry.cc <= 127)
+                {
+                  auto& slots = cc_vec_cache_slots_[entry.cc];
+                  if (slots.empty() || slots.back() != uint (slot))
+                    slots.push_back (slot);
+                }
+            }
+        });
+    }
+  n_cc_vec_cache_slots_ = slot_map.size();
+}
+
+void
+Synth::init_start_templates()
+{
+  for (auto& region : regions_)
+    Voice::init_start_template (region, sample_rate_);
+}
+
+static bool
+has_static_filter (const Region& region)
+{
+  auto static_params = [] (const FilterParams& fil)
+    {
+      return fil.cutoff_cc.empty() && fil.resonance_cc.empty() && fil.keytrack == 0 && fil.veltrack == 0;
+    };
+  if (region.fil.type == Filter::Type::NONE || !static_params (region.fil))
+    return false;
+
+  if (region.fil2.type != Filter::Type::NONE && !static_params (region.fil2))
+    return false;
+
+  const auto& depth = region.fileg_depth;
+  if (depth.base != 0 || depth.vel2 != 0 || !depth.cc_vec.empty())
+    return false;
+
+  /* lfos could modulate the cutoff or change the volume after the filter */
+  if (!region.lfos.empty())
+    return false;
+
+  for (const auto& eq : region.eq_params)
+    if (eq.used)
+      return false;
+
+  /* volume, pan, amplitude and width are applied after the filter, so they
+   * must not change while the voice is playing (the synth gain is applied
+   * on the bus output instead)
+   */
+  const uint post_filter_deps = CC_DEP_VOLUME | CC_DEP_PAN | CC_DEP_AMPLITUDE | CC_DEP_CC7_CC10 | CC_DEP_WIDTH;
+  for (auto deps : region.cc_deps)
+    if (deps & post_filter_deps)
+      return false;
+
+  return true;
+}
+
+void
+Synth::init_filter_buses()
+{
+  /* the filter is linear and time invariant if its parameters are constant,
+   * so filtering the sum of the voices gives the same result as filtering
+   * each voice
+   */
+  std::map<std::tuple<Filter::Type, float, float, Filter::Type, float, float>, int> bus_map;
+  std::vector<const Region *> bus_regions;
+  for (auto& region : regions_)
+    {
+      region.filter_bus = -1;
+      if (!has_static_filter (region))
+        continue;
+
+      auto key = std::make_tuple (region.fil.type, region.fil.cutoff, region.fil.resonance,
+                                  region.fil2.type, region.fil2.cutoff, region.fil2.resonance);
+      auto it = bus_map.find (key);
+      if (it == bus_map.end())
+        {
+          it = bus_map.emplace (key, bus_regions.size()).first;
+          bus_regions.push_back (&region);
+        }
+      region.filter_bus = it->second;
+    }
+
+  /* the cascades point to the filters of the bus, so the vector must not be resized afterwards */
+  filter_buses_.clear();
+  filter_buses_.resize (bus_regions.size());
+  for (size_t b = 0; b < filter_buses_.size(); b++)
+    {
+      const Region *region = bus_regions[b];
+      FilterBus& bus = filter_buses_[b];
+      bus.type  = region->fil.type;
+      bus.cr    = Filter::CR (region->fil.cutoff, region->fil.resonance);
+      bus.type2 = region->fil2.type;
+      bus.cr2   = Filter::CR (region->fil2.cutoff, region->fil2.resonance);
+      reset_filter_bus (b);
+    }
+  filter_bus_buffers_.assign (render_pool_.n_threads() * filter_buses_.size() * 2 * MAX_BLOCK_SIZE, 0);
+}
+
+void
+Synth::reset_filter_bus (uint b)
+{
+  FilterBus& bus = filter_buses_[b];
+
+  bus.filter.reset (bus.type, sample_rate_);
+  bus.cascade.reset();
+  bus.cascade.add_filter (bus.filter, bus.cr);
+  if (bus.type2 != Filter::Type::NONE)
+    {
+      bus.filter2.reset (bus.type2, sample_rate_);
+      bus.cascade.add_filter (bus.filter2, bus.cr2);
+    }
+  bus.gain.reset (sample_rate_, 0.020);
+  bus.gain.set (gain_, true);
+  bus.used = false;
+  bus.active = false;
+  bus.ring_out = true;
+}
+
 void
 Synth::all_sound_off()
 {
@@ -116,6 +492,9 @@ Synth::all_sound_off()
     voice.kill();
 
   update_idle_voices();
+
+  for (uint b = 0; b < filter_buses_.size(); b++)
+    reset_filter_bus (b);
 }
 
 void
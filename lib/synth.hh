@@ -11,6 +11,7 @@
 #include "utils.hh"
 #include "envelope.hh"
 #include "voice.hh"
+#include "renderpool.hh"
 #include "liquidsfz.hh"
 
 namespace LiquidSFZInternal
@@ -23,9 +24,23 @@ struct Channel
   std::vector<uint8_t> cc_values = std::vector<uint8_t> (128, 0);
   int pitch_bend = 0x2000;
 
+  struct CCVecCacheEntry
+  {
+    float value = 0;
+    bool  valid = false;
+  };
+  /* active voices for each key, in the order they were started */
+  std::array<VoiceList<&Voice::key_node_>, 128> key_voices;
+
+  /* evaluated CCParamVec sums, indexed by CCParamVec::cache_slot_ */
+  std::vector<CCVecCacheEntry> cc_vec_cache;
+
   void
-  init (const Control& control)
+  init (const Control& control, size_t n_cc_vec_cache_slots)
   {
+    /* does not allocate memory if the number of slots didn't change */
+    cc_vec_cache.assign (n_cc_vec_cache_slots, CCVecCacheEntry());
+
     std::fill (cc_values.begin(), cc_values.end(), 0);
     for (auto set_cc : control.set_cc)
       if (set_cc.cc >= 0 && set_cc.cc <= 127)
@@ -83,7 +98,7 @@ private:
   std::vector<Voice>   voices_;
   std::vector<Voice *> active_voices_;
   std::vector<Voice *> idle_voices_;
-  bool                 idle_voices_changed_ = false;
+  std::atomic<bool>    idle_voices_changed_ = false; // set by Voice::kill(), which may run in a render thread
   std::vector<Region>  regions_;
   Control control_;
   std::vector<ProgramInfo> bank_programs_;
@@ -97,10 +112,25 @@ private:
   float gain_ = 1.0;
   bool  live_mode_ = true;
   int   sample_quality_ = 3;
+  bool  adaptive_quality_ = false;
   uint  preload_time_ = 500;
+  bool  half_rate_samples_ = false;
+  bool  preload_all_ = false;
   std::array<bool, 128> is_key_switch_;
   std::array<bool, 128> is_supported_cc_;
 
+  /* per key region lists, so trigger_regions() only looks at regions that can match */
+  std::array<std::vector<Region *>, 128> attack_regions_;
+  std::array<std::vector<Region *>, 128> release_regions_;
+  std::array<std::vector<Region *>, 128> switch_regions_;
+
+  /* active voices for each off_by value used by the instrument */
+  std::vector<VoiceList<&Voice::off_by_node_>> off_by_voices_;
+
+  /* for each cc: cache slots of the CCParamVec sums that depend on it */
+  std::array<std::vector<uint>, 128> cc_vec_cache_slots_;
+  size_t                             n_cc_vec_cache_slots_ = 0;
+
   static constexpr int CC_ALL_SOUND_OFF = 120;
   static constexpr int CC_ALL_NOTES_OFF = 123;
 
@@ -111,13 +141,53 @@ private:
 
   std::array<float, MAX_BLOCK_SIZE> const_block_0_, const_block_1_;
 
+  /* parallel voice rendering: job 0 renders to the output, the other jobs to render_buffers_ */
+  static constexpr uint MIN_VOICES_PER_THREAD = 2;
+  RenderPool           render_pool_;
+  std::vector<float>   render_buffers_;
+  std::vector<Voice *> parallel_voices_;
+
+  /* voices of regions with identical static filter settings are mixed into a
+   * shared filter bus, which is filtered once per block instead of once per voice
+   */
+  struct FilterBus
+  {
+    Filter::Type  type = Filter::Type::NONE;
+    Filter::Type  type2 = Filter::Type::NONE;
+    Filter::CR    cr { 0, 0 };
+    Filter::CR    cr2 { 0, 0 };
+    Filter        filter;
+    Filter        filter2;
+    FilterCascade cascade;
+    LinearSmooth  gain;           // synth gain, applied after the filter
+    bool          used = false;   // voices were mixed into the bus during this block
+    bool          active = false; // the filter output has not decayed yet
+    bool          ring_out = true; // false if the last voice mixed into the bus was stopped with fast off
+  };
+  std::vector<FilterBus> filter_buses_;
+  std::vector<float>     filter_bus_buffers_; // for each render job and bus: left and right block
+
+  float *
+  filter_bus_buffer (uint job, uint bus)
+  {
+    return &filter_bus_buffers_[(job * filter_buses_.size() + bus) * 2 * MAX_BLOCK_SIZE];
+  }
+  void init_filter_buses();
+  void reset_filter_bus (uint bus);
+  void process_voice (Voice *voice, float **outputs, uint n_frames, uint job);
+  void process_filter_buses (float **outputs, uint n_frames, uint n_jobs);
+
   void
   init_channels()
   {
     for (auto& channel : channels_)
-      channel.init (control_);
+      channel.init (control_, n_cc_vec_cache_slots_);
   }
   void sort_events_stable();
+  void build_region_index();
+  void build_cc_vec_cache();
+  void init_start_templates();
+  void process_voices_parallel (float **outputs, uint n_frames);
 public:
   Synth() :
     global_ (Global::get()) // init data shared between all Synth instances
@@ -141,6 +211,9 @@ public:
   set_sample_rate (uint sample_rate)
   {
     sample_rate_ = sample_rate;
+
+    init_start_templates();
+    init_filter_buses();
   }
   uint
   sample_rate()
@@ -155,6 +228,13 @@ public:
     idle_voices_.clear();
     idle_voices_changed_ = false;
 
+    /* voice lists would point to deleted voices */
+    for (auto& channel : channels_)
+      for (auto& key_voices : channel.key_voices)
+        key_voices.clear();
+    for (auto& off_by_voices : off_by_voices_)
+      off_by_voices.clear();
+
     for (uint i = 0; i < n_voices; i++)
       voices_.emplace_back (this, limits_);
 
@@ -162,6 +242,7 @@ public:
       idle_voices_.push_back (&voice);
 
     active_voices_.reserve (n_voices);
+    parallel_voices_.reserve (n_voices);
   }
   uint
   max_voices()
@@ -189,9 +270,29 @@ public:
     return preload_time_;
   }
   void
+  set_half_rate_samples (bool half_rate_samples)
+  {
+    half_rate_samples_ = half_rate_samples;
+  }
+  bool
+  half_rate_samples() const
+  {
+    return half_rate_samples_;
+  }
+  void
+  set_preload_all (bool preload_all)
+  {
+    preload_all_ = preload_all;
+  }
+  bool
+  preload_all() const
+  {
+    return preload_all_;
+  }
+  void
   set_sample_quality (int sample_quality)
   {
-    sample_quality_ = std::clamp (sample_quality, 1, 3);
+    sample_quality_ = std::clamp (sample_quality, 1, 4);
   }
   int
   sample_quality()
@@ -199,8 +300,34 @@ public:
     return sample_quality_;
   }
   void
+  set_adaptive_quality (bool adaptive_quality)
+  {
+    adaptive_quality_ = adaptive_quality;
+  }
+  bool
+  adaptive_quality() const
+  {
+    return adaptive_quality_;
+  }
+  void
+  set_render_threads (uint n_threads)
+  {
+    n_threads = std::clamp (n_threads, 1u, 64u);
+
+    render_pool_.set_n_threads (n_threads);
+    render_buffers_.assign ((n_threads - 1) * 2 * MAX_BLOCK_SIZE, 0);
+    init_filter_buses();
+  }
+  uint
+  render_threads() const
+  {
+    return render_pool_.n_threads();
+  }
+  void
   set_channels (uint n_channels)
   {
+    all_sound_off(); // active voices must not refer to channels that get deleted
+
     channels_.resize (n_channels);
     init_channels();
   }
@@ -211,6 +338,8 @@ public:
 
     for (Voice *voice : active_voices_)
       voice->update_gain();
+    for (auto& bus : filter_buses_)
+      bus.gain.set (gain_, !bus.active); // idle buses start with the new gain
   }
   float
   gain() const
@@ -255,6 +384,11 @@ public:
           if (c.cc >= 0 && uint (c.cc) < is_supported_cc_.size())
             is_supported_cc_[c.cc] = true;
 
+        build_region_index();
+        build_cc_vec_cache();
+        init_start_templates();
+        init_filter_buses();
+
         // we must reinit all voices
         //  - ensure that there are no pointers to old regions (which are deleted)
         //  - adjust voice state to the new global limits for this sfz
@@ -289,6 +423,9 @@ public:
     is_key_switch_.fill (false);
     is_supported_cc_.fill (false);
 
+    build_region_index();
+    init_filter_buses();
+
     // we must reinit all voices
     //  - ensure that there are no pointers to old regions (which are deleted)
     set_max_voices (voices_.size());
@@ -335,6 +472,22 @@ public:
     return nullptr;
   }
   void
+  link_voice (Voice *voice)
+  {
+    channels_[voice->channel_].key_voices[voice->key_].push_back (voice);
+    if (voice->region_->off_by_list >= 0)
+      off_by_voices_[voice->region_->off_by_list].push_back (voice);
+  }
+  void
+  unlink_voice (Voice *voice)
+  {
+    channels_[voice->channel_].key_voices[voice->key_].remove (voice);
+    if (voice->region_->off_by_list >= 0)
+      off_by_voices_[voice->region_->off_by_list].remove (voice);
+    if (voice->region_->filter_bus >= 0)
+      filter_buses_[voice->region_->filter_bus].ring_out = voice->off_mode_ != OffMode::FAST;
+  }
+  void
   idle_voices_changed()
   {
     idle_voices_changed_ = true;
@@ -352,6 +505,7 @@ public:
 
             if (voice->state_ == Voice::IDLE)    // voice used?
               {
+                unlink_voice (voice);
                 idle_voices_.push_back (voice);
               }
            else
@@ -398,7 +552,8 @@ public:
   note_on (int chan, int key, int vel)
   {
     /* kill overlapping notes */
-    for (Voice *voice : active_voices_)
+    const auto& key_voices = channels_[chan].key_voices[key];
+    for (Voice *voice = key_voices.first(); voice; voice = key_voices.next (voice))
       {
         if (voice->state_ == Voice::ACTIVE &&
             voice->trigger_ == Trigger::ATTACK &&
@@ -410,6 +565,11 @@ public:
     trigger_regions (Trigger::ATTACK, chan, key, vel, /* time_since_note_on */ 0.0);
   }
 
+  void
+  set_random_seed (uint seed)
+  {
+    random_gen_.seed (seed, 0);
+  }
   double
   normalized_random_value()
   {
@@ -429,23 +589,32 @@ public:
     // - random must be <  1.0  (and never 1.0)
     double random = normalized_random_value();
 
-    for (auto& region : regions_)
+    if (key < 0 || key > 127)
+      {
+        debug ("trigger_regions: bad key %d\n", key);
+        return;
+      }
+    if (is_key_switch_[key] && trigger == Trigger::ATTACK)
       {
-        if (is_key_switch_[key] && region.sw_lokey <= key && region.sw_hikey >= key && trigger == Trigger::ATTACK)
-          region.switch_match = region.sw_lolast <= key && region.sw_hilast >= key;
+        for (Region *region : switch_regions_[key])
+          region->switch_match = region->sw_lolast <= key && region->sw_hilast >= key;
+      }
 
-        if (region.lokey <= key && region.hikey >= key &&
-            region.lovel <= vel && region.hivel >= vel &&
-            region.trigger == trigger)
+    const auto& candidate_regions = trigger == Trigger::ATTACK ? attack_regions_[key] : release_regions_[key];
+    for (Region *region_ptr : candidate_regions)
+      {
+        Region& region = *region_ptr;
+
+        if (region.lovel <= vel && region.hivel >= vel)
           {
             bool cc_match = true;
-            for (size_t cc = 0; cc < region.locc.size(); cc++)
+            for (const auto& cc_range : region.cc_ranges)
               {
-                if (region.locc[cc] != 0 || region.hicc[cc] != 127)
+                const int val = get_cc (chan, cc_range.cc);
+                if (val < cc_range.lo || val > cc_range.hi)
                   {
-                    const int val = get_cc (chan, cc);
-                    if (val < region.locc[cc] || val > region.hicc[cc])
-                      cc_match = false;
+                    cc_match = false;
+                    break;
                   }
               }
             if (!cc_match)
@@ -463,16 +632,17 @@ public:
                     if (region.cached_sample || region.generator != Generator::NONE)
                       {
                         /* handle off_by */
-                        if (region.group)
+                        if (region.group_list >= 0)
                           {
-                            for (Voice *voice : active_voices_)
+                            const auto& off_by_voices = off_by_voices_[region.group_list];
+                            for (Voice *voice = off_by_voices.first(); voice; voice = off_by_voices.next (voice))
                               {
                                 if (voice->state_ == Voice::ACTIVE)
                                   {
                                     /* off_by should not affect voices started by this trigger_regions call */
                                     const bool voice_is_new = (voice->start_frame_count_ == global_frame_count);
 
-                                    if (voice->off_by() == region.group && !voice_is_new)
+                                    if (!voice_is_new)
                                       {
                                         voice->stop (voice->region_->off_mode);
                                       }
@@ -484,7 +654,10 @@ public:
                             /* start new voice */
                             auto voice = alloc_voice();
                             if (voice)
-                              voice->start (region, chan, key, vel, time_since_note_on, global_frame_count, sample_rate_);
+                              {
+                                voice->start (region, chan, key, vel, time_since_note_on, global_frame_count, sample_rate_);
+                                link_voice (voice);
+                              }
                           }
                       }
                   }
@@ -499,7 +672,8 @@ public:
   void
   note_off (int chan, int key)
   {
-    for (Voice *voice : active_voices_)
+    const auto& key_voices = channels_[chan].key_voices[key];
+    for (Voice *voice = key_voices.first(); voice; voice = key_voices.next (voice))
       {
         if (voice->state_ == Voice::ACTIVE &&
             voice->trigger_ == Trigger::ATTACK &&
@@ -551,11 +725,15 @@ public:
       }
     ch.cc_values[controller] = value;
 
+    for (uint slot : cc_vec_cache_slots_[controller])
+      ch.cc_vec_cache[slot].valid = false;
+
     for (Voice *voice : active_voices_)
       {
         if (voice->channel_ == channel)
           {
-            voice->update_cc (controller);
+            if (voice->region_->cc_deps[controller])
+              voice->update_cc (controller);
 
             if (voice->state_ == Voice::SUSTAIN && controller == voice->region_->sustain_cc && value < 0x40)
               release (*voice);
@@ -614,37 +792,71 @@ public:
     return value;
   }
   float
-  get_cc_vec_value (const Voice *voice, const CCParamVec& cc_param_vec) const
+  get_ext_cc_value (const Voice *voice, const CCParamVec& cc_param_vec, const CCParamVec::Entry& entry) const
   {
-    float value = 0.0;
-    for (const auto& entry : cc_param_vec)
+    if (entry.cc == EXT_CC_NOTE_KEY)
       {
-        if (entry.cc <= 127)
-          {
-            value += get_cc_curve (voice->channel_, entry) * entry.value;
-          }
-        else if (entry.cc == EXT_CC_NOTE_KEY)
-          {
-            float f = voice->key_ * (1 / 127.f);
-            value += ext_cc_curve (entry, f) * entry.value;
-          }
-        else if (entry.cc == EXT_CC_NOTE_ON_VELOCITY)
+        float f = voice->key_ * (1 / 127.f);
+        return ext_cc_curve (entry, f) * entry.value;
+      }
+    else if (entry.cc == EXT_CC_NOTE_ON_VELOCITY)
+      {
+        float f = voice->velocity_ * (1 / 127.f);
+        return ext_cc_curve (entry, f) * entry.value;
+      }
+    else if (entry.cc == EXT_CC_RANDOM_UNIPOLAR)
+      {
+        float f = voice->random_helper (cc_param_vec.id()) * (1.f / (1LL << 32)); // range [0:1]
+        return ext_cc_curve (entry, f) * entry.value;
+      }
+    else if (entry.cc == EXT_CC_RANDOM_BIPOLAR)
+      {
+        float f = voice->random_helper (cc_param_vec.id()) * (1.f / (1LL << 31)); // range [0:2]
+        /* we don't support curves for random bipolar because it is not
+         * clear how to deal with a signed value
+         */
+        return (f - 1) * entry.value;
+      }
+    return 0;
+  }
+  float
+  get_cc_vec_value (const Voice *voice, const CCParamVec& cc_param_vec)
+  {
+    const int slot = cc_param_vec.cache_slot_;
+    if (slot < 0)
+      {
+        /* no cache slot: evaluate all entries */
+        float value = 0.0;
+        for (const auto& entry : cc_param_vec)
           {
-            float f = voice->velocity_ * (1 / 127.f);
-            value += ext_cc_curve (entry, f) * entry.value;
+            if (entry.cc <= 127)
+              value += get_cc_curve (voice->channel_, entry) * entry.value;
+            else
+              value += get_ext_cc_value (voice, cc_param_vec, entry);
           }
-        else if (entry.cc == EXT_CC_RANDOM_UNIPOLAR)
+        return value;
+      }
+
+    /* the sum of the cc entries only changes if one of its ccs changes (see update_cc) */
+    auto& cache_entry = channels_[voice->channel_].cc_vec_cache[slot];
+    if (!cache_entry.valid)
+      {
+        float value = 0.0;
+        for (const auto& entry : cc_param_vec)
           {
-            float f = voice->random_helper (cc_param_vec.id()) * (1.f / (1LL << 32)); // range [0:1]
-            value += ext_cc_curve (entry, f) * entry.value;
+            if (entry.cc <= 127)
+              value += get_cc_curve (voice->channel_, entry) * entry.value;
           }
-        else if (entry.cc == EXT_CC_RANDOM_BIPOLAR)
+        cache_entry.value = value;
+        cache_entry.valid = true;
+      }
+    float value = cache_entry.value;
+    if (cc_param_vec.has_ext_cc_)
+      {
+        for (const auto& entry : cc_param_vec)
           {
-            float f = voice->random_helper (cc_param_vec.id()) * (1.f / (1LL << 31)); // range [0:2]
-            /* we don't support curves for random bipolar because it is not
-             * clear how to deal with a signed value
-             */
-            value += (f - 1) * entry.value;
+            if (entry.cc > 127)
+              value += get_ext_cc_value (voice, cc_param_vec, entry);
           }
       }
     return value;
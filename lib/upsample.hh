@@ -2,6 +2,10 @@
 
 #pragma once
 
+#include <algorithm>
+
+#include "utils.hh"
+
 namespace LiquidSFZInternal
 {
 
@@ -87,4 +91,87 @@ upsample (const float *in, float *out)
     }
 }
 
+/* coefficients c1 .. c11 of upsample() */
+static constexpr int UPSAMPLE_TAPS = 11;
+static constexpr float upsample_coeffs[UPSAMPLE_TAPS] = {
+  // ---- generated table by gen-upsample.py ----
+  0.63237116454128905f, -0.1997498002401274f, 0.10748860423425083f, -0.064996197861812793f,
+  0.040215547574385509f, -0.024427947042245154f, 0.014168419143340378f, -0.00763898924164643f,
+  0.0036936200627533675f, -0.0015023373417955108f, 0.00043564746173319177f
+};
+
+/*
+ * upsample n_frames consecutive frames, produces the same output as calling
+ * upsample() for each frame: in[-10 * CHANNELS] .. in[(n_frames + 10) * CHANNELS]
+ * must be readable, out receives 2 * n_frames * CHANNELS values
+ *
+ * the loops run over frames (with the same order of operations for each frame
+ * as upsample()), so they can be vectorized by the compiler
+ */
+template<int CHANNELS>
+LIQUIDSFZ_CPU_DISPATCH void
+upsample_block (const float *in, float *out, uint n_frames)
+{
+  static_assert (CHANNELS == 1 || CHANNELS == 2);
+
+  constexpr uint BLOCK = 64;
+  constexpr int  TAIL = UPSAMPLE_TAPS - 1;
+  for (uint start = 0; start < n_frames; start += BLOCK)
+    {
+      const uint todo = std::min (n_frames - start, BLOCK);
+      const float *block_in = in + start * CHANNELS;
+      float *block_out = out + 2 * start * CHANNELS;
+
+      for (int c = 0; c < CHANNELS; c++)
+        {
+          /* contiguous input for this channel: x[i + TAIL] = block_in[i * CHANNELS + c] */
+          float x[BLOCK + 2 * UPSAMPLE_TAPS];
+          for (int i = -TAIL; i < int (todo) + UPSAMPLE_TAPS; i++)
+            x[i + TAIL] = block_in[i * CHANNELS + c];
+
+          float odd[BLOCK];
+          for (uint i = 0; i < todo; i++)
+            odd[i] = 0;
+
+          for (int k = 1; k <= UPSAMPLE_TAPS; k++)
+            {
+              const float ck = upsample_coeffs[k - 1];
+              const float *x_a = x + TAIL + 1 - k;
+              const float *x_b = x + TAIL + k;
+
+              for (uint i = 0; i < todo; i++)
+                odd[i] += (x_a[i] + x_b[i]) * ck;
+            }
+          for (uint i = 0; i < todo; i++)
+            {
+              block_out[(2 * i) * CHANNELS + c] = x[i + TAIL];
+              block_out[(2 * i + 1) * CHANNELS + c] = odd[i];
+            }
+        }
+    }
+}
+
+/*
+ * halfband lowpass filter + 2x decimation, using the coefficients of
+ * upsample(): out frame i is the average of in frame 2i and the value
+ * upsample() would compute for that position from the odd input frames, so
+ * in[-21 * channels] .. in[(2 * n_frames + 20) * channels] must be readable
+ */
+inline void
+downsample_2x (const float *in, float *out, uint n_frames, uint channels)
+{
+  const int stride = channels;
+  for (uint i = 0; i < n_frames; i++)
+    {
+      for (uint c = 0; c < channels; c++)
+        {
+          const float *x = in + 2 * i * channels + c;
+          float odd = 0;
+          for (int k = 1; k <= UPSAMPLE_TAPS; k++)
+            odd += (x[(1 - 2 * k) * stride] + x[(2 * k - 1) * stride]) * upsample_coeffs[k - 1];
+          out[i * channels + c] = 0.5f * (x[0] + odd);
+        }
+    }
+}
+
 }
@@ -23,8 +23,28 @@
   #define LIQUIDSFZ_OS_WINDOWS 1
 #endif
 
+#if __APPLE__
+  #define LIQUIDSFZ_OS_MACOS 1
+#endif
+
 #define LIQUIDSFZ_ALWAYS_INLINE inline __attribute__((always_inline))
 
+/* DSP kernels marked with LIQUIDSFZ_CPU_DISPATCH are compiled for baseline
+ * x86-64 and for AVX2; the version matching the CPU is chosen by the dynamic
+ * linker (ifunc) when the program starts
+ *
+ * FMA is not enabled on purpose: contracting a * b + c changes the rounding,
+ * so the output would depend on the machine and on how the code was inlined
+ *
+ * this is only used with GCC, for other compilers the macro expands to nothing;
+ * tests/testdispatch.sh checks that the output doesn't depend on the dispatch
+ */
+#if LIQUIDSFZ_COMP_GCC && defined (__x86_64__) && defined (__ELF__) && !defined (__AVX2__) && !defined (LIQUIDSFZ_NO_CPU_DISPATCH)
+  #define LIQUIDSFZ_CPU_DISPATCH __attribute__ ((target_clones ("default", "avx2")))
+#else
+  #define LIQUIDSFZ_CPU_DISPATCH
+#endif
+
 #if INTPTR_MAX == INT64_MAX
   #define LIQUIDSFZ_64BIT 1 // 64-bit
 #elif INTPTR_MAX == INT32_MAX
@@ -130,11 +150,35 @@ public:
         return linear_value_;
       }
   }
+  /* write the next n_values values, equivalent to calling get_next() n_values times */
+  void
+  process (float *values, uint n_values)
+  {
+    const uint  n_ramp = std::min (steps_, n_values);
+    const float start = linear_value_;
+    const float step = linear_step_;
+    for (uint i = 0; i < n_ramp; i++)
+      values[i] = start + (i + 1) * step;
+    for (uint i = n_ramp; i < n_values; i++)
+      values[i] = value_;
+
+    if (n_ramp)
+      {
+        linear_value_ = values[n_ramp - 1];
+        steps_ -= n_ramp;
+      }
+  }
   bool
   is_constant()
   {
     return steps_ == 0;
   }
+  /* upper bound for the values of the current ramp */
+  float
+  max_value() const
+  {
+    return steps_ ? std::max (linear_value_, value_) : value_;
+  }
 };
 
 }
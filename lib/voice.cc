@@ -3,10 +3,11 @@
 #include <math.h>
 
 #include <array>
+#include <type_traits>
+#include <vector>
 
 #include "voice.hh"
 #include "synth.hh"
-#include "upsample.hh"
 
 using namespace LiquidSFZInternal;
 
@@ -25,6 +26,93 @@ static const auto sin_table = []() {
   return table;
 } ();
 
+/*
+ * Polyphase windowed sinc tables for quality 4
+ *
+ * For each band, there are SINC_PHASES + 1 rows of SINC_TAPS coefficients:
+ * row p contains the Kaiser windowed sinc kernel for the fractional position
+ * p / SINC_PHASES, the interpolator linearly interpolates between two rows.
+ * The cutoff of band b is lowered by the factor 2^(b / 4), so high
+ * transpositions don't alias. Above 4x playback speed (the last band), the
+ * cutoff is not lowered any further.
+ */
+static constexpr int    SINC_TAPS = 32;
+static constexpr int    SINC_PHASES = 64;
+static constexpr int    SINC_BANDS = 9;
+static constexpr double SINC_CUTOFF = 0.45;  // relative to sample rate, for band 0
+static constexpr double SINC_KAISER_BETA = 8;
+
+static double
+bessel_i0 (double x)
+{
+  double sum = 1, term = 1;
+  for (int k = 1; k < 50; k++)
+    {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+      if (term < sum * 1e-12)
+        break;
+    }
+  return sum;
+}
+
+static const auto sinc_table = []() {
+  std::vector<float> table (SINC_BANDS * (SINC_PHASES + 1) * SINC_TAPS);
+  for (int b = 0; b < SINC_BANDS; b++)
+    {
+      const double fc = 2 * SINC_CUTOFF / exp2 (b / 4.0);
+      for (int p = 0; p <= SINC_PHASES; p++)
+        {
+          float *row = &table[(b * (SINC_PHASES + 1) + p) * SINC_TAPS];
+          double sum = 0;
+          double h[SINC_TAPS];
+          for (int t = 0; t < SINC_TAPS; t++)
+            {
+              /* tap t is the sample at (integer position - SINC_TAPS / 2 + 1 + t) */
+              const double d = t - (SINC_TAPS / 2 - 1) - double (p) / SINC_PHASES;
+              const double w = d / (SINC_TAPS / 2);
+              const double x = M_PI * fc * d;
+              const double window = fabs (w) < 1 ? bessel_i0 (SINC_KAISER_BETA * sqrt (1 - w * w)) / bessel_i0 (SINC_KAISER_BETA) : 0;
+              h[t] = (fabs (x) < 1e-9 ? 1 : sin (x) / x) * window;
+              sum += h[t];
+            }
+          /* normalize DC gain */
+          for (int t = 0; t < SINC_TAPS; t++)
+            row[t] = h[t] / sum;
+        }
+    }
+  return table;
+} ();
+
+static constexpr int SINC_TABLE_SIZE = (SINC_PHASES + 1) * SINC_TAPS; // one band
+
+/* Returns the table for a playback speed. Between two bands, the tables are
+ * linearly interpolated (into blend_table), so the cutoff changes smoothly if
+ * the speed is modulated (pitch bend, lfo) instead of jumping from band to band.
+ *
+ * The band position is shifted by half a band, so the higher cutoff of the
+ * two bands that are mixed stays below the nyquist frequency of the output.
+ * Below band 1, the position ramps up faster, so that speeds up to 1 use band
+ * 0 only.
+ */
+static inline const float *
+sinc_band_table (double speed, float *blend_table)
+{
+  const double octave_pos = speed > 1 ? log2 (speed) * 4 : 0;
+  const double band_pos = std::min<double> (octave_pos < 1 ? octave_pos * 1.5 : octave_pos + 0.5, SINC_BANDS - 1);
+  const int    band = band_pos;
+  const float  frac = band_pos - band;
+
+  const float *table = &sinc_table[band * SINC_TABLE_SIZE];
+  if (frac == 0)
+    return table;
+
+  const float *next_table = table + SINC_TABLE_SIZE;
+  for (int i = 0; i < SINC_TABLE_SIZE; i++)
+    blend_table[i] = table[i] + frac * (next_table[i] - table[i]);
+  return blend_table;
+}
+
 }
 
 double
@@ -35,6 +123,59 @@ Voice::pan_stereo_factor (double region_pan, int ch)
   return sin ((pan + 100) / 400 * M_PI);
 }
 
+void
+Voice::init_start_template (Region& region, uint sample_rate)
+{
+  auto& st = region.start_template;
+
+  st.sample_rate = sample_rate;
+
+  st.const_volume_gain = region.gain_cc.empty();
+  if (st.const_volume_gain)
+    {
+      float volume = region.volume + region.group_volume + region.master_volume + region.global_volume;
+      st.volume_gain = db_to_factor (volume);
+    }
+
+  st.const_pan_gain = region.pan_cc.empty();
+  if (st.const_pan_gain)
+    {
+      float pan = clamp (region.pan, -100.f, 100.f);
+      st.pan_left_gain = pan_stereo_factor (pan, 0);
+      st.pan_right_gain = pan_stereo_factor (pan, 1);
+    }
+
+  st.eq_Q.clear();
+  for (const auto& p : region.eq_params)
+    {
+      if (p.freq_cc.empty() && p.bw_cc.empty())
+        st.eq_Q.push_back (Filter::convert_bw_to_Q_freq_dependent (p.bw, p.freq, sample_rate));
+      else
+        st.eq_Q.push_back (-1);
+    }
+}
+
+bool
+Voice::need_half_rate_sample (const Region& region, uint sample_rate)
+{
+  /* looping the half rate copy only works if both loop points are at even frames */
+  if (region.loop_mode == LoopMode::SUSTAIN || region.loop_mode == LoopMode::CONTINUOUS)
+    {
+      if (region.loop_start % 2 != 0 || (region.loop_end + 1) % 2 != 0)
+        return false;
+    }
+
+  /* highest replay speed for this region, not counting modulation other than pitch bend */
+  const double keytrack = region.pitch_keytrack * 0.01;
+  double semi_tones = std::max ((region.lokey - region.pitch_keycenter) * keytrack, (region.hikey - region.pitch_keycenter) * keytrack);
+  semi_tones += std::max (region.pitch_veltrack, 0) * 0.01;
+  semi_tones += (region.tune + std::max (region.pitch_random, 0)) * 0.01;
+  semi_tones += region.transpose;
+  semi_tones += std::max (region.bend_up, 0) * 0.01;
+
+  return exp2 (semi_tones / 12) * region.cached_sample->sample_rate() / sample_rate >= HALF_RATE_MIN_SPEED;
+}
+
 double
 Voice::velocity_track_factor (const Region& r, int midi_velocity)
 {
@@ -77,7 +218,7 @@ Voice::update_replay_speed (bool now)
     }
   else
     {
-      replay_speed_.set (exp2f (semi_tones / 12) * region_->cached_sample->sample_rate() / sample_rate_, now);
+      replay_speed_.set (exp2f (semi_tones / 12) * region_->cached_sample->sample_rate() / (sample_rate_ * decimation_), now);
     }
 }
 
@@ -129,6 +270,7 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
     }
 
   quality_ = synth_->sample_quality();
+  full_quality_ = quality_;
   int upsample = quality_ == 3 ? 2 : 1; // upsample for best quality interpolator
 
   update_volume_gain();
@@ -138,6 +280,7 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
   update_lr_gain (true);
   update_width_factor (true);
 
+  decimation_ = 1;
   set_pitch_bend (synth_->get_pitch_bend (channel));
   update_replay_speed (true);
 
@@ -151,6 +294,8 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
   envelope_.start (region, sample_rate_);
 
   state_ = ACTIVE;
+  off_mode_ = OffMode::NORMAL;
+  xfade_frames_ = XFADE_FRAMES;
 
   synth_->debug ("location %s\n", region.location.c_str());
   if (region.generator == Generator::NONE)
@@ -159,16 +304,31 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
       uint offset = region.offset;
       offset += lrint (region.offset_random * synth_->normalized_random_value());
       offset += lrint (synth_->get_cc_vec_value (this, region.offset_cc));
-      ppos_ = offset * upsample;
-      if (ppos_ > region.loop_end * upsample)
+      if (int64_t (offset) > region.loop_end)
         loop_enabled_ = false;
 
+      /* notes that are transposed up a lot are played from the half rate copy,
+       * which reads half as many frames and doesn't contain frequencies that
+       * would alias
+       */
+      Sample *sample = region.cached_sample.get();
+      if (region.half_rate_sample && replay_speed_.get_next() >= HALF_RATE_MIN_SPEED)
+        {
+          decimation_ = 2;
+          sample = region.half_rate_sample.get();
+          update_replay_speed (true);
+        }
+      ppos_ = (uint64_t (offset * upsample) << 32) / decimation_;
       last_ippos_ = 0;
 
-      play_handle_.start_playback (region.cached_sample.get(), synth_->live_mode());
-      sample_reader_.restart (&play_handle_, region.cached_sample.get(), upsample, region.end);
+      play_handle_.start_playback (sample, synth_->live_mode());
+      sample_reader_.restart (&play_handle_, sample, upsample, region.end / decimation_);
       if (loop_enabled_)
-        sample_reader_.set_loop (region.loop_start, region.loop_end, region.loop_count);
+        {
+          const auto& loop_seam = decimation_ == 1 ? region.loop_seam : region.half_rate_loop_seam;
+          sample_reader_.set_loop (region.loop_start / decimation_, (region.loop_end + 1) / decimation_ - 1, region.loop_count,
+                                   loop_seam.empty() ? nullptr : loop_seam.data());
+        }
 
       channels_ = region.cached_sample->channels();
       synth_->debug ("new voice %s - channels %d\n", region.sample.c_str(), channels_);
@@ -193,6 +353,7 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
 
   start_filter (fimpl_, &region.fil);
   start_filter (fimpl2_, &region.fil2);
+  filter_cascade_.reset();
 
   for (size_t i = 0; i < MAX_EQ_BANDS; i++)
     {
@@ -211,6 +372,8 @@ Voice::start (const Region& region, int channel, int key, int velocity, double t
 
 
   lfo_gen_.start (region, sample_rate_);
+
+  select_process_func();
 }
 
 void
@@ -251,6 +414,14 @@ Voice::amp_value (float vnorm, const EGParam& amp_param)
 void
 Voice::update_pan_gain()
 {
+  const auto& st = region_->start_template;
+  if (st.const_pan_gain)
+    {
+      pan_left_gain_ = st.pan_left_gain;
+      pan_right_gain_ = st.pan_right_gain;
+      return;
+    }
+
   float pan = region_->pan;
   pan += synth_->get_cc_vec_value (this, region_->pan_cc);
   pan = clamp (pan, -100.f, 100.f);
@@ -285,7 +456,9 @@ void
 Voice::update_lr_gain (bool now)
 {
   const float phase_invert = region_->phase == Phase::INVERT ? -1 : 1;
-  const float global_gain = synth_->gain() * volume_gain_ * velocity_gain_ * rt_decay_gain_ * amplitude_gain_ * phase_invert;
+  /* voices on a filter bus get the synth gain on the bus output, after the filter */
+  const float synth_gain = region_->filter_bus >= 0 ? 1 : synth_->gain();
+  const float global_gain = synth_gain * volume_gain_ * velocity_gain_ * rt_decay_gain_ * amplitude_gain_ * phase_invert;
 
   synth_->debug (" - gain l=%.2f r=%.2f\n", 32768 * pan_left_gain_ * global_gain, 32768 * pan_right_gain_ * global_gain);
   left_gain_.set (cc7_cc10_left_gain_ * pan_left_gain_ * global_gain, now);
@@ -333,10 +506,18 @@ Voice::xfout_gain (int value, int lo, int hi, XFCurve curve)
 void
 Voice::update_volume_gain()
 {
-  float volume = region_->volume + region_->group_volume + region_->master_volume + region_->global_volume;
-  volume += synth_->get_cc_vec_value (this, region_->gain_cc);
+  const auto& st = region_->start_template;
+  if (st.const_volume_gain)
+    {
+      volume_gain_ = st.volume_gain;
+    }
+  else
+    {
+      float volume = region_->volume + region_->group_volume + region_->master_volume + region_->global_volume;
+      volume += synth_->get_cc_vec_value (this, region_->gain_cc);
 
-  volume_gain_ = db_to_factor (volume);
+      volume_gain_ = db_to_factor (volume);
+    }
 
   volume_gain_ *= amp_random_gain_;
   volume_gain_ *= xfin_gain (velocity_, region_->xfin_lovel, region_->xfin_hivel, region_->xf_velcurve);
@@ -408,13 +589,20 @@ Voice::update_eq_band (EQBand& b)
 
   b.freq = freq;
   b.gain = gain;
-  b.Q = Filter::convert_bw_to_Q_freq_dependent (bw, freq, sample_rate_);
+
+  const auto& st = region_->start_template;
+  const size_t band_index = b.params - region_->eq_params.data();
+  if (st.sample_rate == uint (sample_rate_) && st.eq_Q[band_index] >= 0)
+    b.Q = st.eq_Q[band_index];
+  else
+    b.Q = Filter::convert_bw_to_Q_freq_dependent (bw, freq, sample_rate_);
 }
 
 void
 Voice::stop (OffMode off_mode)
 {
   state_ = Voice::RELEASED;
+  off_mode_ = off_mode;
   envelope_.stop (off_mode);
   filter_envelope_.stop (OffMode::NORMAL);
 
@@ -437,64 +625,56 @@ Voice::kill()
 void
 Voice::update_cc (int controller)
 {
-  if (region_->xfin_ccs.size() || region_->xfout_ccs.size())
+  /* Region::cc_deps tells us which parameters depend on this controller */
+  const uint cc_deps = region_->cc_deps[controller];
+
+  bool update_lr = false;
+  if (cc_deps & CC_DEP_VOLUME)
     {
       update_volume_gain();
-      update_lr_gain (false);
+      update_lr = true;
     }
-  if (region_->pan_cc.contains (controller))
+  if (cc_deps & CC_DEP_PAN)
     {
       update_pan_gain();
-      update_lr_gain (false);
+      update_lr = true;
     }
-  if (region_->gain_cc.contains (controller))
-    {
-      update_volume_gain();
-      update_lr_gain (false);
-    }
-  if (region_->amplitude_cc.contains (controller))
+  if (cc_deps & CC_DEP_AMPLITUDE)
     {
       update_amplitude_gain();
-      update_lr_gain (false);
+      update_lr = true;
     }
-  if (controller == 7 || controller == 10)
+  if (cc_deps & CC_DEP_CC7_CC10)
     {
       update_cc7_cc10_gain();
-      update_lr_gain (false);
+      update_lr = true;
     }
+  if (update_lr)
+    update_lr_gain (false);
 
-  if (region_->tune_cc.contains (controller))
+  if (cc_deps & CC_DEP_TUNE)
     update_replay_speed (false);
-  if (region_->width_cc.contains (controller))
+  if (cc_deps & CC_DEP_WIDTH)
     update_width_factor (false);
 
-  auto update_filter = [controller, this] (FImpl& fi)
-    {
-      if (fi.params->cutoff_cc.contains (controller))
-        update_cutoff (fi, false);
-
-      if (fi.params->resonance_cc.contains (controller))
-        update_resonance (fi, false);
-    };
-  update_filter (fimpl_);
-  update_filter (fimpl2_);
+  if (cc_deps & CC_DEP_FIL_CUTOFF)
+    update_cutoff (fimpl_, false);
+  if (cc_deps & CC_DEP_FIL_RESONANCE)
+    update_resonance (fimpl_, false);
+  if (cc_deps & CC_DEP_FIL2_CUTOFF)
+    update_cutoff (fimpl2_, false);
+  if (cc_deps & CC_DEP_FIL2_RESONANCE)
+    update_resonance (fimpl2_, false);
 
-  // Check if any EQ parameters use this controller - update only affected bands
-  for (auto& b : eq_bands_)
+  // update only EQ bands that use this controller
+  for (size_t i = 0; i < MAX_EQ_BANDS; i++)
     {
-      if (!b.params) // band not used
-        continue;
-
-      const auto& p = *b.params;
-      if (p.freq_cc.contains (controller) ||
-          p.gain_cc.contains (controller) ||
-          p.bw_cc.contains (controller))
-        {
-          update_eq_band (b); // Only update the specific band that uses this CC
-        }
+      if (cc_deps & (CC_DEP_EQ1 << i))
+        update_eq_band (eq_bands_[i]);
     }
 
-  lfo_gen_.update_ccs();
+  if (cc_deps & CC_DEP_LFO)
+    lfo_gen_.update_ccs();
 }
 
 void
@@ -516,42 +696,158 @@ Voice::update_pitch_bend (int bend)
   update_replay_speed (false);
 }
 
+template<int QUALITY, int CHANNELS, Generator GENERATOR>
+Voice::ProcessFunc
+Voice::process_func (bool filter, bool lfo)
+{
+  if (filter)
+    {
+      if (lfo)
+        return &Voice::process_impl<QUALITY, CHANNELS, GENERATOR, true, true>;
+      else
+        return &Voice::process_impl<QUALITY, CHANNELS, GENERATOR, true, false>;
+    }
+  else
+    {
+      if (lfo)
+        return &Voice::process_impl<QUALITY, CHANNELS, GENERATOR, false, true>;
+      else
+        return &Voice::process_impl<QUALITY, CHANNELS, GENERATOR, false, false>;
+    }
+}
+
+/* choose the process_impl specialization for the features this voice uses */
 void
-Voice::process (float **outputs, uint n_frames)
+Voice::select_process_func()
 {
+  bool filter = false;
+  /* voices mixed into a filter bus are filtered by the synth */
+  if (region_->filter_bus < 0)
+    filter = fimpl_.params->type != Filter::Type::NONE || fimpl2_.params->type != Filter::Type::NONE;
+  for (auto& band : eq_bands_)
+    if (band.params)
+      filter = true;
+
+  const bool lfo = lfo_gen_.need_process();
+
   if (region_->generator == Generator::SILENCE)
     {
-      process_impl<1, 1, Generator::SILENCE> (outputs, n_frames);
+      process_func_ = process_func<1, 1, Generator::SILENCE> (filter, lfo);
     }
   else if (region_->generator == Generator::NOISE)
     {
-      process_impl<1, 1, Generator::NOISE> (outputs, n_frames);
+      process_func_ = process_func<1, 1, Generator::NOISE> (filter, lfo);
     }
   else if (region_->generator == Generator::SINE)
     {
-      process_impl<1, 1, Generator::SINE> (outputs, n_frames);
+      process_func_ = process_func<1, 1, Generator::SINE> (filter, lfo);
     }
   else if (quality_ == 1)
     {
       if (channels_ == 1)
-        process_impl<1, 1, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<1, 1, Generator::NONE> (filter, lfo);
       else
-        process_impl<1, 2, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<1, 2, Generator::NONE> (filter, lfo);
     }
   else if (quality_ == 2)
     {
       if (channels_ == 1)
-        process_impl<2, 1, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<2, 1, Generator::NONE> (filter, lfo);
       else
-        process_impl<2, 2, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<2, 2, Generator::NONE> (filter, lfo);
     }
   else if (quality_ == 3)
     {
       if (channels_ == 1)
-        process_impl<3, 1, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<3, 1, Generator::NONE> (filter, lfo);
       else
-        process_impl<3, 2, Generator::NONE> (outputs, n_frames);
+        process_func_ = process_func<3, 2, Generator::NONE> (filter, lfo);
+    }
+  else
+    {
+      if (channels_ == 1)
+        process_func_ = process_func<4, 1, Generator::NONE> (filter, lfo);
+      else
+        process_func_ = process_func<4, 2, Generator::NONE> (filter, lfo);
+    }
+}
+
+void
+Voice::process (float **outputs, uint n_frames)
+{
+  if (synth_->adaptive_quality())
+    update_adaptive_quality();
+
+  (this->*process_func_) (outputs, n_frames);
+}
+
+/* use linear interpolation while the voice is quiet
+ *
+ * the quality only changes while the level is at -60..-54 dB, where the
+ * difference between the interpolators is far below the audible range;
+ * set_quality() crossfades the interpolators so the switch doesn't cause a
+ * step, and the hysteresis avoids switching back and forth on every block
+ */
+void
+Voice::update_adaptive_quality()
+{
+  constexpr int   QUIET_QUALITY = 1;
+  constexpr float QUIET_LEVEL = 0.001;         // -60 dB
+  constexpr float LOUD_LEVEL = 2 * QUIET_LEVEL; // -54 dB
+
+  if (region_->generator != Generator::NONE || full_quality_ == QUIET_QUALITY)
+    return;
+
+  /* we can't predict the lfo volume modulation */
+  if (lfo_gen_.has_output (LFOGen::VOLUME))
+    return;
+
+  /* resonant filters and eq bands can boost the voice (by up to 40 dB and 24 dB) */
+  float filter_gain = 1;
+  for (const FImpl *fi : { &fimpl_, &fimpl2_ })
+    if (fi->params->type != Filter::Type::NONE)
+      filter_gain *= fi->filter.max_gain (fi->resonance_smooth.max_value());
+  for (const auto& band : eq_bands_)
+    if (band.params)
+      filter_gain *= band.eq.max_gain (band.gain);
+
+  float level = envelope_.max_level() * std::max (left_gain_.max_value(), right_gain_.max_value()) * filter_gain;
+  if (region_->filter_bus >= 0)
+    level *= synth_->gain(); // applied on the bus output
+  if (quality_ != QUIET_QUALITY && level < QUIET_LEVEL)
+    set_quality (QUIET_QUALITY);
+  else if (quality_ == QUIET_QUALITY && level > LOUD_LEVEL)
+    set_quality (full_quality_);
+}
+
+void
+Voice::set_quality (int quality)
+{
+  const int old_upsample = quality_ == 3 ? 2 : 1;
+  const int new_upsample = quality == 3 ? 2 : 1;
+
+  /* the old interpolator continues from the current position for XFADE_FRAMES frames */
+  xfade_reader_ = sample_reader_;
+  xfade_quality_ = quality_;
+  xfade_ppos_ = ppos_;
+  xfade_last_ippos_ = last_ippos_;
+  xfade_frames_ = 0;
+
+  /* positions are in 2x upsampled frames for quality 3 */
+  if (new_upsample > old_upsample)
+    {
+      ppos_ <<= 1;
+      last_ippos_ <<= 1;
     }
+  else if (new_upsample < old_upsample)
+    {
+      ppos_ >>= 1;
+      last_ippos_ >>= 1;
+    }
+  sample_reader_.change_upsample (old_upsample, new_upsample);
+
+  quality_ = quality;
+  select_process_func();
 }
 
 /*----- interpolation helpers -----*/
@@ -582,11 +878,190 @@ interp_hermite_6p3o (float ym2, float ym1, float y0, float y1, float y2, float y
   return (((c3*x+c2)*x+c1)*x) * (1/12.0f) + y0;
 }
 
-template<int QUALITY, int CHANNELS, Generator GENERATOR>
+template<int QUALITY, uint TAPS, uint BLOCK>
+static inline void
+interpolate (const float *taps, const float *fracs, const float *amp_gains, float *out, uint n_frames)
+{
+  for (uint i = 0; i < n_frames; i++)
+    {
+      auto x = [&] (uint t) { return taps[t * BLOCK + i]; };
+
+      if constexpr (QUALITY == 1)
+        out[i] = (x (0) + fracs[i] * (x (1) - x (0))) * amp_gains[i];
+      if constexpr (QUALITY == 2)
+        out[i] = interp_hermite_6p3o (x (0), x (1), x (2), x (3), x (4), x (5), fracs[i]) * amp_gains[i];
+      if constexpr (QUALITY == 3)
+        out[i] = interp_optimal_2x_4p (x (0), x (1), x (2), x (3), fracs[i]) * amp_gains[i];
+    }
+}
+
+/* quality 4: taps are stored frame by frame, so both dot products run over contiguous memory */
+static inline void
+interpolate_sinc (const float *taps, const float *table, const float *fracs, const float *amp_gains, float *out, uint n_frames)
+{
+  for (uint i = 0; i < n_frames; i++)
+    {
+      const float *x = taps + i * SINC_TAPS;
+      const float phase = fracs[i] * SINC_PHASES;
+      const int   iphase = std::min<int> (phase, SINC_PHASES - 1); // frac can be rounded to 1.0
+      const float *h0 = table + iphase * SINC_TAPS;
+      const float *h1 = h0 + SINC_TAPS;
+
+      /* sum in LANES independent partial sums, which the compiler can map to SIMD registers */
+      constexpr int LANES = 8;
+      float a0[LANES] = { 0, }, a1[LANES] = { 0, };
+      for (int t = 0; t < SINC_TAPS; t += LANES)
+        for (int l = 0; l < LANES; l++)
+          {
+            a0[l] += x[t + l] * h0[t + l];
+            a1[l] += x[t + l] * h1[t + l];
+          }
+      float s0 = 0, s1 = 0;
+      for (int l = 0; l < LANES; l++)
+        {
+          s0 += a0[l];
+          s1 += a1[l];
+        }
+      out[i] = (s0 + (phase - iphase) * (s1 - s0)) * amp_gains[i];
+    }
+}
+
+/* number of frames that are interpolated in one pass */
+static constexpr uint RENDER_BLOCK_SIZE = 64;
+
+/* gather the interpolation input samples for (up to) RENDER_BLOCK_SIZE
+ * positions into one array per tap (using a contiguous span from the sample
+ * reader if possible), then interpolate all frames at once in loops the
+ * compiler can vectorize
+ *
+ * returns the number of frames rendered, which is less than n_positions if
+ * the sample reader is done
+ */
+template<int QUALITY, int CHANNELS>
+static LIQUIDSFZ_ALWAYS_INLINE uint
+render_block (SampleReader& sample_reader, uint32_t& last_ippos, const uint32_t *ipositions, const float *fracs, const float *amp_gains,
+              uint n_positions, uint64_t ppos_delta, float *out_l, float *out_r)
+{
+  constexpr int UPSAMPLE = QUALITY == 3 ? 2 : 1;
+  constexpr uint TAPS = QUALITY == 1 ? 2 : (QUALITY == 2 ? 6 : (QUALITY == 3 ? 4 : SINC_TAPS));
+  constexpr uint BLOCK = RENDER_BLOCK_SIZE;
+
+  /* the sinc interpolator wants the taps of one frame next to each other, the others the frames of one tap */
+  auto tap_index = [] (uint t, uint j) { return QUALITY == 4 ? j * TAPS + t : t * BLOCK + j; };
+
+  float taps[CHANNELS][TAPS * BLOCK];
+  float upsample_buffer[UPSAMPLE == 2 ? (SampleReader::MAX_SPAN_FRAMES * 2 + 2) * CHANNELS : 1];
+  float sinc_blend_table[QUALITY == 4 ? SINC_TABLE_SIZE : 1];
+
+  const float *span = nullptr;
+  if (n_positions > 0 && !sample_reader.done())
+    span = sample_reader.skip_span<UPSAMPLE, CHANNELS, TAPS> (ipositions[0] - last_ippos, ipositions[n_positions - 1] - last_ippos, upsample_buffer);
+
+  uint n_gathered = 0;
+  if (span)
+    {
+      /* all samples are in one contiguous block */
+      for (uint j = 0; j < n_positions; j++)
+        {
+          const float *samples = span + int (ipositions[j] - ipositions[0]) * CHANNELS;
+          for (uint t = 0; t < TAPS; t++)
+            for (uint c = 0; c < CHANNELS; c++)
+              taps[c][tap_index (t, j)] = samples[t * CHANNELS + c];
+        }
+      last_ippos = ipositions[n_positions - 1];
+      n_gathered = n_positions;
+    }
+  else
+    {
+      while (n_gathered < n_positions && !sample_reader.done())
+        {
+          const int delta_pos = ipositions[n_gathered] - last_ippos;
+          last_ippos = ipositions[n_gathered];
+
+          const float *samples = sample_reader.skip<UPSAMPLE, CHANNELS, TAPS> (delta_pos);
+          for (uint t = 0; t < TAPS; t++)
+            for (uint c = 0; c < CHANNELS; c++)
+              taps[c][tap_index (t, n_gathered)] = samples[t * CHANNELS + c];
+
+          n_gathered++;
+        }
+    }
+  if constexpr (QUALITY == 4)
+    {
+      /* choose the sinc cutoff from the average playback speed of this block */
+      const float *table = nullptr;
+      if (n_gathered)
+        table = sinc_band_table (ppos_delta / (n_positions * 4294967296.0), sinc_blend_table);
+
+      for (uint c = 0; c < CHANNELS; c++)
+        interpolate_sinc (taps[c], table, fracs, amp_gains, c == 0 ? out_l : out_r, n_gathered);
+    }
+  else
+    {
+      for (uint c = 0; c < CHANNELS; c++)
+        interpolate<QUALITY, TAPS, BLOCK> (taps[c], fracs, amp_gains, c == 0 ? out_l : out_r, n_gathered);
+    }
+  return n_gathered;
+}
+
+/* after a quality switch, render the block with the old interpolator too and crossfade to the new one */
+template<int CHANNELS>
+void
+Voice::crossfade_block (const float *speeds, const float *lfo_pitch, const float *amp_gains, uint n_positions, uint n_gathered,
+                        float *out_l, float *out_r)
+{
+  const int upsample = xfade_quality_ == 3 ? 2 : 1;
+
+  /* positions for the old interpolator, advanced with the same speeds as the new positions */
+  float fracs[RENDER_BLOCK_SIZE];
+  uint32_t ipositions[RENDER_BLOCK_SIZE];
+  const uint64_t block_start_ppos = xfade_ppos_;
+  const uint64_t step = speeds ? 0 : fixed_step (replay_speed_.get_next() * upsample);
+  for (uint j = 0; j < n_positions; j++)
+    {
+      ipositions[j] = fixed_ipos (xfade_ppos_);
+      fracs[j] = fixed_frac (xfade_ppos_);
+
+      xfade_ppos_ += speeds ? fixed_step (speeds[j] * lfo_pitch[j] * upsample) : step;
+    }
+
+  float old_l[RENDER_BLOCK_SIZE];
+  float old_r[RENDER_BLOCK_SIZE];
+  uint n_old = 0;
+  auto render_old = [&] (auto quality)
+    {
+      n_old = render_block<decltype (quality)::value, CHANNELS> (xfade_reader_, xfade_last_ippos_, ipositions, fracs, amp_gains, n_positions,
+                                                                 xfade_ppos_ - block_start_ppos, old_l, old_r);
+    };
+  switch (xfade_quality_)
+    {
+      case 1:   render_old (std::integral_constant<int, 1>());
+                break;
+      case 2:   render_old (std::integral_constant<int, 2>());
+                break;
+      case 3:   render_old (std::integral_constant<int, 3>());
+                break;
+      default:  render_old (std::integral_constant<int, 4>());
+    }
+  /* if the old sample reader is done before the new one, it continues with silence */
+  std::fill (old_l + n_old, old_l + RENDER_BLOCK_SIZE, 0.f);
+  std::fill (old_r + n_old, old_r + RENDER_BLOCK_SIZE, 0.f);
+
+  for (uint j = 0; j < n_gathered; j++)
+    {
+      const float w = std::min (xfade_frames_ + j + 1, XFADE_FRAMES) * (1.f / XFADE_FRAMES);
+      out_l[j] = old_l[j] + w * (out_l[j] - old_l[j]);
+      if (CHANNELS == 2)
+        out_r[j] = old_r[j] + w * (out_r[j] - old_r[j]);
+    }
+  xfade_frames_ = std::min (xfade_frames_ + n_positions, XFADE_FRAMES);
+}
+
+template<int QUALITY, int CHANNELS, Generator GENERATOR, bool FILTER, bool LFO>
 void
 Voice::process_impl (float **orig_outputs, uint orig_n_frames)
 {
-  static_assert (QUALITY >= 1 || QUALITY <= 3);
+  static_assert (QUALITY >= 1 && QUALITY <= 4);
   static_assert (CHANNELS == 1 || CHANNELS == 2);
   constexpr int UPSAMPLE = QUALITY == 3 ? 2 : 1;
 
@@ -603,11 +1078,18 @@ Voice::process_impl (float **orig_outputs, uint orig_n_frames)
     };
 
   /* render lfos */
-  float lfo_buffer[LFOGen::MAX_OUTPUTS * Synth::MAX_BLOCK_SIZE];
-  if (lfo_gen_.need_process())
+  float lfo_buffer[LFO ? LFOGen::MAX_OUTPUTS * Synth::MAX_BLOCK_SIZE : 1];
+  if constexpr (LFO)
     lfo_gen_.process (lfo_buffer, n_frames);
 
-  const float *lfo_pitch = lfo_gen_.get (LFOGen::PITCH);
+  auto lfo_output = [&] (LFOGen::OutputType type) -> const float *
+    {
+      if constexpr (LFO)
+        return lfo_gen_.get (type);
+      else
+        return nullptr;
+    };
+  const float *lfo_pitch = lfo_output (LFOGen::PITCH);
   if (!lfo_pitch)
     lfo_pitch = synth_->const_block_1();
 
@@ -619,20 +1101,26 @@ Voice::process_impl (float **orig_outputs, uint orig_n_frames)
     {
       static_assert (CHANNELS == 1 && QUALITY == 1);
 
+      float amp_gains[Synth::MAX_BLOCK_SIZE];
+      envelope_.process (amp_gains, n_frames);
+
+      float speeds[GENERATOR == Generator::SINE ? Synth::MAX_BLOCK_SIZE : 1];
+      if constexpr (GENERATOR == Generator::SINE)
+        replay_speed_.process (speeds, n_frames);
+
       for (uint i = 0; i < n_frames; i++)
         {
-          const float amp_gain = envelope_.get_next();
+          const float amp_gain = amp_gains[i];
           if constexpr (GENERATOR == Generator::SILENCE)
             out_l[i] = 0;
           if constexpr (GENERATOR == Generator::NOISE)
             out_l[i] = (synth_->raw_random_value() * float (1.0 / uint (1 << 31)) - 1) * amp_gain;
           if constexpr (GENERATOR == Generator::SINE)
             {
-              int64_t ipos = ppos_;
-              const float frac = ppos_ - ipos;
-              ipos &= SIN_TABLE_SIZE - 1;
+              const uint ipos = fixed_ipos (ppos_) & (SIN_TABLE_SIZE - 1);
+              const float frac = fixed_frac (ppos_);
               out_l[i] = (sin_table[ipos] + frac * (sin_table[ipos + 1] - sin_table[ipos])) * amp_gain;
-              ppos_ += replay_speed_.get_next() * lfo_pitch[i];
+              ppos_ += fixed_step (speeds[i] * lfo_pitch[i]);
             }
         }
       if (envelope_.done())
@@ -640,108 +1128,121 @@ Voice::process_impl (float **orig_outputs, uint orig_n_frames)
     }
   else
     {
-      for (uint i = 0; i < n_frames; i++)
+      /* The per frame work is split in passes: first the sample positions are
+       * advanced, then render_block() gathers the interpolation input samples
+       * and interpolates all frames of the block at once
+       */
+      constexpr uint BLOCK = RENDER_BLOCK_SIZE;
+
+      float fracs[BLOCK];
+      float amp_gains[BLOCK];
+      float speeds[BLOCK];
+      uint32_t ipositions[BLOCK];
+
+      /* without pitch modulation, the position advances by the same step for every frame */
+      const bool const_step = replay_speed_.is_constant() && !lfo_output (LFOGen::PITCH);
+
+      uint i = 0;
+      while (i < n_frames)
         {
-          if (!sample_reader_.done() && !envelope_.done())
-            {
-              const int64_t ippos = ppos_;
-              const int delta_pos = ippos - last_ippos_;
-              const float frac = ppos_ - ippos;
-              last_ippos_ = ippos;
+          const uint todo = std::min (n_frames - i, BLOCK);
 
-              ppos_ += replay_speed_.get_next() * lfo_pitch[i] * UPSAMPLE;
+          /* positions and envelope for this block; if the sample reader is
+           * done before the end of the block, the voice is killed anyway so
+           * advancing them too far is harmless
+           */
+          const uint n_positions = envelope_.process (amp_gains, todo);
 
-              const float amp_gain = envelope_.get_next();
-              if (CHANNELS == 1)
-                {
-                  if constexpr (QUALITY == 1)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 2> (delta_pos);
-
-                      out_l[i] = (samples[0] + frac * (samples[1] - samples[0])) * amp_gain;
-                    }
-                  if constexpr (QUALITY == 2)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 6> (delta_pos);
-
-                      out_l[i] = interp_hermite_6p3o (samples[0], samples[1], samples[2], samples[3], samples[4], samples[5], frac) * amp_gain;
-                    }
-                  if constexpr (QUALITY == 3)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 4> (delta_pos);
-
-                      out_l[i] = interp_optimal_2x_4p (samples[0], samples[1], samples[2], samples[3], frac) * amp_gain;
-                    }
-                }
-              else if (CHANNELS == 2)
+          const uint64_t block_start_ppos = ppos_;
+
+          if (const_step)
+            {
+              const uint64_t step = fixed_step (replay_speed_.get_next() * UPSAMPLE);
+              for (uint j = 0; j < n_positions; j++)
                 {
-                  if constexpr (QUALITY == 1)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 2> (delta_pos);
-
-                      out_l[i] = (samples[0] + frac * (samples[2] - samples[0])) * amp_gain;
-                      out_r[i] = (samples[1] + frac * (samples[3] - samples[1])) * amp_gain;
-                    }
-                  if constexpr (QUALITY == 2)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 6> (delta_pos);
-
-                      out_l[i] = interp_hermite_6p3o (samples[0], samples[2], samples[4], samples[6], samples[8], samples[10], frac) * amp_gain;
-                      out_r[i] = interp_hermite_6p3o (samples[1], samples[3], samples[5], samples[7], samples[9], samples[11], frac) * amp_gain;
-                    }
-                  if constexpr (QUALITY == 3)
-                    {
-                      const float *samples = sample_reader_.skip<UPSAMPLE, CHANNELS, 4> (delta_pos);
-
-                      out_l[i] = interp_optimal_2x_4p (samples[0], samples[2], samples[4], samples[6], frac) * amp_gain;
-                      out_r[i] = interp_optimal_2x_4p (samples[1], samples[3], samples[5], samples[7], frac) * amp_gain;
-                    }
+                  const uint64_t pos = ppos_ + j * step;
+                  ipositions[j] = fixed_ipos (pos);
+                  fracs[j] = fixed_frac (pos);
                 }
-              else
+              ppos_ += n_positions * step;
+            }
+          else
+            {
+              replay_speed_.process (speeds, n_positions);
+
+              for (uint j = 0; j < n_positions; j++)
                 {
-                  assert (false);
+                  ipositions[j] = fixed_ipos (ppos_);
+                  fracs[j] = fixed_frac (ppos_);
+
+                  ppos_ += fixed_step (speeds[j] * lfo_pitch[i + j] * UPSAMPLE);
                 }
             }
-          else
+
+          const uint n_gathered = render_block<QUALITY, CHANNELS> (sample_reader_, last_ippos_, ipositions, fracs, amp_gains, n_positions,
+                                                                   ppos_ - block_start_ppos, out_l + i, out_r + i);
+          if (xfade_frames_ < XFADE_FRAMES)
+            crossfade_block<CHANNELS> (const_step ? nullptr : speeds, lfo_pitch + i, amp_gains, n_positions, n_gathered, out_l + i, out_r + i);
+
+          if (n_gathered < todo)
             {
               kill();
 
-              /* output memory is uninitialized, so we need to explicitely write every sampl when done */
-              out_l[i] = 0;
-              out_r[i] = 0;
+              /* output memory is uninitialized, so we need to explicitely write every sample when done */
+              for (uint j = i + n_gathered; j < n_frames; j++)
+                {
+                  out_l[j] = 0;
+                  out_r[j] = 0;
+                }
+              break;
             }
+          i += todo;
         }
     }
 
-  /* process filters */
-  if (fimpl_.params->type != Filter::Type::NONE)
-    process_filter (fimpl_, true, out_l, out_r, n_frames, lfo_gen_.get (LFOGen::CUTOFF));
+  /* process filters and EQ bands in one pass */
+  if constexpr (FILTER)
+    {
+      static_assert (2 + MAX_EQ_BANDS <= FilterCascade::MAX_FILTERS && 3 + 3 + MAX_EQ_BANDS <= FilterCascade::MAX_STAGES);
 
-  if (fimpl2_.params->type != Filter::Type::NONE)
-    process_filter (fimpl2_, false, out_l, out_r, n_frames, nullptr);
+      uint       config_pos[FilterCascade::max_config_positions (Synth::MAX_BLOCK_SIZE)];
+      Filter::CR filter_cr[FilterCascade::max_config_positions (Synth::MAX_BLOCK_SIZE)];
+      Filter::CR filter2_cr[FilterCascade::max_config_positions (Synth::MAX_BLOCK_SIZE)];
 
-  /* process EQ bands */
-  for (auto& band : eq_bands_)
-  {
-    if (!band.params) // band not used
-      continue;
-
-    if (CHANNELS == 2)
-      {
-        band.eq.process_peq (out_l, out_r, band.freq, band.Q, band.gain, n_frames);
-      }
-    else
-      {
-        band.eq.process_peq_mono (out_l, band.freq, band.Q, band.gain, n_frames);
-      }
-  }
+      const uint n_config_pos = filter_cascade_.config_positions (n_frames, config_pos);
+
+      filter_cascade_.clear();
+      /* if the voice is mixed into a filter bus, the synth runs the filters on the bus */
+      if (region_->filter_bus < 0)
+        {
+          if (fimpl_.params->type != Filter::Type::NONE)
+            {
+              filter_params (fimpl_, true, n_frames, lfo_output (LFOGen::CUTOFF), config_pos, n_config_pos, filter_cr);
+              filter_cascade_.add_filter (fimpl_.filter, filter_cr);
+            }
+          if (fimpl2_.params->type != Filter::Type::NONE)
+            {
+              filter_params (fimpl2_, false, n_frames, nullptr, config_pos, n_config_pos, filter2_cr);
+              filter_cascade_.add_filter (fimpl2_.filter, filter2_cr);
+            }
+        }
+      for (auto& band : eq_bands_)
+        {
+          if (band.params) // band used
+            filter_cascade_.add_peq (band.eq, band.freq, band.Q, band.gain);
+        }
+      if (CHANNELS == 2)
+        filter_cascade_.process (out_l, out_r, n_frames);
+      else
+        filter_cascade_.process_mono (out_l, n_frames);
+    }
 
   /* process width */
   if (CHANNELS == 2)
     process_width (out_l, out_r, n_frames);
 
   /* add samples to output buffer */
-  const float *lfo_volume = lfo_gen_.get (LFOGen::VOLUME);
+  const float *lfo_volume = lfo_output (LFOGen::VOLUME);
   const bool   const_gain = (!lfo_volume && left_gain_.is_constant() && right_gain_.is_constant());
   if (!lfo_volume)
     lfo_volume = synth_->const_block_1();
@@ -761,10 +1262,15 @@ Voice::process_impl (float **orig_outputs, uint orig_n_frames)
         }
       else
         {
+          float gain_left[Synth::MAX_BLOCK_SIZE];
+          float gain_right[Synth::MAX_BLOCK_SIZE];
+          left_gain_.process (gain_left, n_frames);
+          right_gain_.process (gain_right, n_frames);
+
           for (uint i = 0; i < n_frames; i++)
             {
-              outputs[0][i] += out_l[i] * lfo_volume[i] * left_gain_.get_next();
-              outputs[1][i] += out_r[i] * lfo_volume[i] * right_gain_.get_next();
+              outputs[0][i] += out_l[i] * lfo_volume[i] * gain_left[i];
+              outputs[1][i] += out_r[i] * lfo_volume[i] * gain_right[i];
             }
         }
     }
@@ -783,28 +1289,33 @@ Voice::process_impl (float **orig_outputs, uint orig_n_frames)
         }
       else
         {
+          float gain_left[Synth::MAX_BLOCK_SIZE];
+          float gain_right[Synth::MAX_BLOCK_SIZE];
+          left_gain_.process (gain_left, n_frames);
+          right_gain_.process (gain_right, n_frames);
+
           for (uint i = 0; i < n_frames; i++)
             {
-              outputs[0][i] += out_l[i] * lfo_volume[i] * left_gain_.get_next();
-              outputs[1][i] += out_l[i] * lfo_volume[i] * right_gain_.get_next();
+              outputs[0][i] += out_l[i] * lfo_volume[i] * gain_left[i];
+              outputs[1][i] += out_l[i] * lfo_volume[i] * gain_right[i];
             }
         }
     }
 }
 
+/* computes the filter parameters for each position in config_pos, advancing the parameter smoothing by n_frames */
 void
-Voice::process_filter (FImpl& fi, bool envelope, float *left, float *right, uint n_frames, const float *lfo_cutoff_factor)
+Voice::filter_params (FImpl& fi, bool envelope, uint n_frames, const float *lfo_cutoff_factor,
+                      const uint *config_pos, uint n_config_pos, Filter::CR *cr)
 {
   float mod_cutoff[Synth::MAX_BLOCK_SIZE];
   float mod_resonance[Synth::MAX_BLOCK_SIZE];
   float mod_env[Synth::MAX_BLOCK_SIZE];
 
-  auto run_filter = [&] (const auto& cr_func)
+  auto compute_cr = [&] (const auto& cr_func)
     {
-      if (channels_ == 2)
-        fi.filter.process_mod (left, right, cr_func, n_frames);
-      else
-        fi.filter.process_mod_mono (left, cr_func, n_frames);
+      for (uint i = 0; i < n_config_pos; i++)
+        cr[i] = cr_func (config_pos[i]);
     };
 
   if (envelope && filter_envelope_depth_)
@@ -816,21 +1327,18 @@ Voice::process_filter (FImpl& fi, bool envelope, float *left, float *right, uint
           float cutoff = fi.cutoff_smooth.get_next() * exp2f (filter_envelope_.get_next() * depth_factor);
           float resonance = fi.resonance_smooth.get_next();
 
-          run_filter ([&] (int i)
+          compute_cr ([&] (int i)
             {
               return Filter::CR (cutoff, resonance);
             });
         }
       else
         {
-          for (uint i = 0; i < n_frames; i++)
-            {
-              mod_cutoff[i]    = fi.cutoff_smooth.get_next();
-              mod_env[i]       = filter_envelope_.get_next();
-              mod_resonance[i] = fi.resonance_smooth.get_next();
-            }
+          filter_envelope_.process (mod_env, n_frames);
+          fi.cutoff_smooth.process (mod_cutoff, n_frames);
+          fi.resonance_smooth.process (mod_resonance, n_frames);
 
-          run_filter ([&] (int i)
+          compute_cr ([&] (int i)
             {
               float cutoff = mod_cutoff[i] * exp2f (mod_env[i] * depth_factor);
               if (lfo_cutoff_factor)
@@ -847,19 +1355,16 @@ Voice::process_filter (FImpl& fi, bool envelope, float *left, float *right, uint
           float cutoff    = fi.cutoff_smooth.get_next();
           float resonance = fi.resonance_smooth.get_next();
 
-          run_filter ([&] (int i)
+          compute_cr ([&] (int i)
             {
               return Filter::CR (cutoff, resonance);
             });
         }
       else
         {
-          for (uint i = 0; i < n_frames; i++)
-            {
-              mod_cutoff[i]    = fi.cutoff_smooth.get_next();
-              mod_resonance[i] = fi.resonance_smooth.get_next();
-            }
-          run_filter ([&] (int i)
+          fi.cutoff_smooth.process (mod_cutoff, n_frames);
+          fi.resonance_smooth.process (mod_resonance, n_frames);
+          compute_cr ([&] (int i)
             {
               float cutoff = mod_cutoff[i];
               if (lfo_cutoff_factor)
@@ -898,8 +1403,11 @@ Voice::process_width (float *out_l, float *out_r, uint n_frames)
     }
   else
     {
+      float width_factors[Synth::MAX_BLOCK_SIZE];
+      width_factor_.process (width_factors, n_frames);
+
       for (uint i = 0; i < n_frames; i++)
-        apply_width (i, width_factor_.get_next());
+        apply_width (i, width_factors[i]);
     }
 }
 
@@ -909,17 +1417,13 @@ SampleReader::skip (int delta)
 {
   relative_pos_ += delta;
 
-  bool in_loop = false;
   if (loop_start_ >= 0)
     {
-      in_loop = (relative_pos_ >= loop_start_ * UPSAMPLE);
-
       while (relative_pos_ > loop_end_ * UPSAMPLE)
         {
           if (loop_iteration_ == loop_count_)
             {
               stop_loop();
-              in_loop = false;
               break;
             }
           else
@@ -935,13 +1439,19 @@ SampleReader::skip (int delta)
     }
 
   static_assert (UPSAMPLE == 1 || UPSAMPLE == 2);
-  static_assert (INTERP_POINTS % 2 == 0);
+  static_assert (INTERP_POINTS % 2 == 0 && INTERP_POINTS <= MAX_INTERP_POINTS);
+
+  /* before the loop start, the interpolator window can still reach the loop end for short loops */
+  const bool in_loop = loop_start_ >= 0;
+
+  /* with loop_start 0, wrapping can make relative_pos_ negative, so we need to round down here */
+  const int index = UPSAMPLE == 2 ? relative_pos_ >> 1 : relative_pos_;
 
   auto close_to_loop_point_or_region_end = [&] (int n)
     {
-      if (in_loop && ((relative_pos_ / UPSAMPLE - loop_start_ < n) || (loop_end_ - relative_pos_ / UPSAMPLE < n)))
+      if (in_loop && index + n > loop_start_ && ((index - loop_start_ < n) || (loop_end_ - index < n)))
         return true;
-      if (region_end_ - relative_pos_ / UPSAMPLE < n)
+      if (region_end_ - index < n)
         return true;
       return false;
     };
@@ -959,6 +1469,8 @@ SampleReader::skip (int delta)
 
       if (!close_to_loop_point_or_region_end (INTERP_POINTS))
         samples = play_handle_->get_n (start_x * CHANNELS, INTERP_POINTS * CHANNELS);
+      else if (in_loop)
+        samples = loop_window<CHANNELS> (start_x, INTERP_POINTS);
 
       if (samples)
         {
@@ -989,21 +1501,25 @@ SampleReader::skip (int delta)
     {
       static_assert (INTERP_POINTS == 4);
 
-      const int N = 24;
+      const int N = UPSAMPLE_INPUT_FRAMES;
       const float *input = nullptr;
 
       if (!close_to_loop_point_or_region_end (N))
         {
-          const int start_x = (relative_pos_ / 2 * CHANNELS) - N * CHANNELS;
+          const int start_x = (index - N) * CHANNELS;
           input = play_handle_->get_n (start_x, N * 2 * CHANNELS);
         }
+      else if (in_loop)
+        {
+          input = loop_window<CHANNELS> (index - N, N * 2);
+        }
 
       float input_stack[N * 2 * CHANNELS];
       if (!input)
         {
           for (int n = 0; n < N * 2; n++)
             {
-              int x = (relative_pos_ / 2) + n - N;
+              int x = index + n - N;
 
               if (in_loop)
                 {
@@ -1021,14 +1537,14 @@ SampleReader::skip (int delta)
         }
       input += N * CHANNELS;
 
-      int diff = relative_pos_ / 2 - last_index_;
+      int diff = index - last_index_;
       if (diff >= 0 && diff < upsample_buffer_size_ - 2)
         {
           // samples are already in upsample buffer
         }
       else
         {
-          last_index_ = relative_pos_ / 2;
+          last_index_ = index;
 
           int i = upsample_buffer_size_ - diff;
           if (i > 0 && i < 3)
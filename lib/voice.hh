@@ -6,6 +6,7 @@
 #include "filter.hh"
 #include "lfogen.hh"
 #include "pcg32rng.hh"
+#include "upsample.hh"
 
 namespace LiquidSFZInternal
 {
@@ -25,8 +26,11 @@ class SampleReader
   bool loop_first_ = true;
   bool loop_last_ = false;
   int upsample_buffer_size_ = 0;
+  const float *loop_seam_ = nullptr;
   static constexpr int MAX_UPSAMPLE_BUFFER_SIZE = 10;
-  std::array<float, MAX_UPSAMPLE_BUFFER_SIZE * 4> samples_; // max: 2x upsampling, stereo
+  static constexpr int UPSAMPLE_INPUT_FRAMES = 24; // input frames around the position used for upsampling
+  static constexpr int MAX_INTERP_POINTS = 32;
+  std::array<float, std::max (MAX_UPSAMPLE_BUFFER_SIZE * 4, MAX_INTERP_POINTS * 2)> samples_; // max: 2x upsampling or sinc, stereo
   int last_index_ = -1000;
 public:
   void
@@ -45,16 +49,21 @@ public:
     loop_last_ = false;
     last_index_ = -1000;
     upsample_buffer_size_ = 0;
+    loop_seam_ = nullptr;
     samples_.fill (0);
   }
+  /* number of frames before and after the loop end in a loop seam (see Sample::read_loop_seam) */
+  static constexpr int LOOP_SEAM_FRAMES = 64;
+
   void
-  set_loop (int loop_start, int loop_end, int loop_count)
+  set_loop (int loop_start, int loop_end, int loop_count, const float *loop_seam)
   {
     if (loop_count > 0) /* loop_count == 0 plays loop section exactly once, so we don't need to loop */
       {
         loop_start_ = loop_start;
         loop_end_ = loop_end;
         loop_count_ = loop_count;
+        loop_seam_ = loop_seam;
       }
   }
   void
@@ -63,10 +72,124 @@ public:
     loop_start_ = -1;
     loop_end_ = -1;
   }
+  /* switch between 2x upsampled and normal positions during playback */
+  void
+  change_upsample (int old_upsample, int new_upsample)
+  {
+    relative_pos_ = relative_pos_ / old_upsample * new_upsample;
+    end_pos_ = end_pos_ / old_upsample * new_upsample;
+    last_index_ = -1000;
+    upsample_buffer_size_ = 0;
+  }
 
   template<int UPSAMPLE, int CHANNELS, int INTERP_POINTS>
   const float *skip (int pos);
 
+  /* Inside the loop, return the frames start_x .. start_x + n_frames - 1 as
+   * they would be read with wraparound at the loop points, from the sample
+   * data if no frame needs to be wrapped or from the loop seam otherwise. If
+   * neither is possible (the window extends beyond a loop point where no
+   * wraparound happens, and also beyond one where it does), return nullptr.
+   */
+  template<int CHANNELS>
+  const float *
+  loop_window (int start_x, int n_frames)
+  {
+    const bool before_start = start_x < loop_start_;
+    const bool after_end = start_x + n_frames - 1 > loop_end_;
+    const bool wrap_start = before_start && !loop_first_;
+    const bool wrap_end = after_end && !loop_last_;
+
+    if (!wrap_start && !wrap_end)
+      {
+        if (start_x + n_frames - 1 > region_end_)
+          return nullptr;
+        return play_handle_->get_n (start_x * CHANNELS, n_frames * CHANNELS);
+      }
+    if ((before_start && !wrap_start) || (after_end && !wrap_end) || !loop_seam_)
+      return nullptr;
+
+    /* the seam starts LOOP_SEAM_FRAMES frames before the loop end and is periodic with the loop length */
+    const int loop_len = loop_end_ - loop_start_ + 1;
+    int offset = (start_x - (loop_end_ + 1 - LOOP_SEAM_FRAMES)) % loop_len;
+    if (offset < 0)
+      offset += loop_len;
+    if (offset + n_frames > 2 * LOOP_SEAM_FRAMES)
+      return nullptr;
+
+    return loop_seam_ + offset * CHANNELS;
+  }
+
+  /* Fast path for a block of skip() calls: if no loop point and no region
+   * end is near the positions (relative_pos_ + first_delta) .. (relative_pos_
+   * + last_delta) and the samples are in one buffer, advance to the last
+   * position and return the interpolation points of the first position,
+   * followed by the samples for all other positions. Otherwise return nullptr
+   * and leave the state unchanged.
+   *
+   * With 2x upsampling, the upsampled samples are written to upsample_buffer,
+   * which needs space for (MAX_SPAN_FRAMES * 2 + 2) * CHANNELS values.
+   */
+  static constexpr int MAX_SPAN_FRAMES = 256;
+  template<int UPSAMPLE, int CHANNELS, int INTERP_POINTS>
+  const float *
+  skip_span (int first_delta, int last_delta, float *upsample_buffer)
+  {
+    const int first = relative_pos_ + first_delta;
+    const int last = relative_pos_ + last_delta;
+
+    /* skip() uses its slow path if positions are closer than this to loop points / region end */
+    const int min_dist = UPSAMPLE == 1 ? INTERP_POINTS : UPSAMPLE_INPUT_FRAMES;
+
+    if (last > end_pos_ || region_end_ - last / UPSAMPLE < min_dist)
+      return nullptr;
+
+    if (loop_start_ >= 0)
+      {
+        const bool before_loop = last < loop_start_ * UPSAMPLE;
+        const bool after_loop_start = first / UPSAMPLE - loop_start_ >= min_dist;
+        if ((!before_loop && !after_loop_start) || loop_end_ - last / UPSAMPLE < min_dist)
+          return nullptr;
+      }
+    if constexpr (UPSAMPLE == 1)
+      {
+        const int start_x = first - (INTERP_POINTS - 2) / 2;
+        const float *samples = play_handle_->get_span (start_x * CHANNELS, (last - first + INTERP_POINTS) * CHANNELS);
+        if (samples)
+          relative_pos_ = last;
+
+        return samples;
+      }
+    else
+      {
+        static_assert (UPSAMPLE == 2 && INTERP_POINTS == 4);
+
+        /* skip() would (partially) reuse its upsample buffer for the first position,
+         * which can contain samples computed with different loop state, so we
+         * only use the fast path if skip() would recompute the buffer
+         */
+        const int diff = (first >> 1) - last_index_;
+        if (diff >= 0 && diff < upsample_buffer_size_)
+          return nullptr;
+
+        /* we need upsampled positions first - 1 .. last + 2, which are computed from these input frames */
+        const int start_x = (first - 1) >> 1;
+        const int end_x = (last + 2) >> 1;
+        const int n_frames = end_x - start_x + 1;
+        if (n_frames > MAX_SPAN_FRAMES)
+          return nullptr;
+
+        const float *input = play_handle_->get_span ((start_x - UPSAMPLE_TAPS + 1) * CHANNELS, (n_frames + 2 * UPSAMPLE_TAPS) * CHANNELS);
+        if (!input)
+          return nullptr;
+
+        upsample_block<CHANNELS> (input + (UPSAMPLE_TAPS - 1) * CHANNELS, upsample_buffer, n_frames);
+        relative_pos_ = last;
+
+        return upsample_buffer + (first - 1 - 2 * start_x) * CHANNELS;
+      }
+  }
+
   bool
   done()
   {
@@ -99,6 +222,8 @@ class Voice
 
   std::array<EQBand, MAX_EQ_BANDS> eq_bands_;
 
+  FilterCascade filter_cascade_;
+
   Sample::PlayHandle play_handle_;
   int                channels_ = 0; /* 1 mono, 2 stereo */
 
@@ -141,6 +266,20 @@ class Voice
 
   SampleReader sample_reader_;
   int          quality_ = 0;
+  int          full_quality_ = 0; // quality_ is lower than this for quiet voices if adaptive quality is enabled
+  uint         decimation_ = 1; // 2 if the half rate copy of the sample is played
+
+  /* crossfade from the old interpolator after an adaptive quality switch */
+  static constexpr uint XFADE_FRAMES = 64;
+  SampleReader xfade_reader_;
+  int          xfade_quality_ = 0;
+  uint         xfade_frames_ = XFADE_FRAMES; // frames since the switch
+  uint64_t     xfade_ppos_ = 0;
+  uint32_t     xfade_last_ippos_ = 0;
+
+  template<int CHANNELS>
+  void crossfade_block (const float *speeds, const float *lfo_pitch, const float *amp_gains, uint n_positions, uint n_gathered,
+                        float *out_l, float *out_r);
 
   void set_pitch_bend (int value);
   void update_replay_speed (bool now);
@@ -159,31 +298,76 @@ public:
     IDLE
   };
   State state_ = IDLE;
+  OffMode off_mode_ = OffMode::NORMAL; // set by stop()
 
-  double ppos_ = 0;
-  int64_t last_ippos_ = 0;
+  /* playback position: 32.32 fixed point, the integer part may wrap around,
+   * only differences between integer positions are used
+   */
+  uint64_t ppos_ = 0;
+  uint32_t last_ippos_ = 0;
+
+  static uint64_t
+  fixed_step (float step)
+  {
+    return uint64_t (step * 4294967296.0 + 0.5);
+  }
+  static uint32_t
+  fixed_ipos (uint64_t pos)
+  {
+    return pos >> 32;
+  }
+  static float
+  fixed_frac (uint64_t pos)
+  {
+    return uint32_t (pos) * (1.f / 4294967296.f);
+  }
   uint64_t start_frame_count_ = 0;
   Trigger trigger_ = Trigger::ATTACK;
   Envelope envelope_;
 
   const Region *region_ = nullptr;
 
+  /* links for the intrusive voice lists maintained by Synth (see VoiceList) */
+  struct ListNode
+  {
+    Voice *prev = nullptr;
+    Voice *next = nullptr;
+  };
+  ListNode key_node_;
+  ListNode off_by_node_;
+
   Voice (Synth *synth,
          const Limits& limits) :
     lfo_gen_ (synth, this, limits),
     synth_ (synth)
   {
   }
-  double pan_stereo_factor (double region_pan, int ch);
+  /* notes with a higher replay speed are played from the half rate copy of the sample */
+  static constexpr float HALF_RATE_MIN_SPEED = 2;
+
+  static double pan_stereo_factor (double region_pan, int ch);
+  static void init_start_template (Region& region, uint sample_rate);
+  static bool need_half_rate_sample (const Region& region, uint sample_rate);
   double velocity_track_factor (const Region& r, int midi_velocity);
 
   void start (const Region& region, int channel, int key, int velocity, double time_since_note_on, uint64_t global_frame_count, uint sample_rate);
   void stop (OffMode off_mode);
   void kill();
   void process (float **outputs, uint n_frames);
+  void update_adaptive_quality();
+  void set_quality (int quality);
+  template<int QUALITY, int CHANNELS, Generator GENERATOR, bool FILTER, bool LFO>
+  LIQUIDSFZ_CPU_DISPATCH void process_impl (float **outputs, uint n_frames);
+
+  /* process_impl specialization for this voice, chosen by start() */
+  using ProcessFunc = void (Voice::*) (float **outputs, uint n_frames);
+  ProcessFunc process_func_ = nullptr;
+
   template<int QUALITY, int CHANNELS, Generator GENERATOR>
-  void process_impl (float **outputs, uint n_frames);
-  void process_filter (FImpl& fi, bool envelope, float *left, float *right, uint n_frames, const float *lfo_cutoff_factor);
+  static ProcessFunc process_func (bool filter, bool lfo);
+  void select_process_func();
+  void filter_params (FImpl& fi, bool envelope, uint n_frames, const float *lfo_cutoff_factor,
+                      const uint *config_pos, uint n_config_pos, Filter::CR *cr);
   void process_width (float *out_l, float *out_r, uint n_frames);
   uint off_by();
   void update_cc (int controller);
@@ -197,4 +381,56 @@ public:
   float apply_xfcurve (float f, XFCurve curve);
 };
 
+/* intrusive doubly linked list of voices, NODE selects which Voice::ListNode is used */
+template<Voice::ListNode Voice::*NODE>
+class VoiceList
+{
+  Voice *first_ = nullptr;
+  Voice *last_ = nullptr;
+public:
+  Voice *
+  first() const
+  {
+    return first_;
+  }
+  static Voice *
+  next (const Voice *voice)
+  {
+    return (voice->*NODE).next;
+  }
+  void
+  push_back (Voice *voice)
+  {
+    auto& node = voice->*NODE;
+    node.prev = last_;
+    node.next = nullptr;
+    if (last_)
+      (last_->*NODE).next = voice;
+    else
+      first_ = voice;
+    last_ = voice;
+  }
+  void
+  remove (Voice *voice)
+  {
+    auto& node = voice->*NODE;
+    if (node.prev)
+      (node.prev->*NODE).next = node.next;
+    else
+      first_ = node.next;
+    if (node.next)
+      (node.next->*NODE).prev = node.prev;
+    else
+      last_ = node.prev;
+    node.prev = nullptr;
+    node.next = nullptr;
+  }
+  void
+  clear()
+  {
+    first_ = nullptr;
+    last_ = nullptr;
+  }
+};
+
 }
@@ -540,6 +540,8 @@ public:
                 break;
         case 3: sample_quality_str = "high";
                 break;
+        case 4: sample_quality_str = "very high";
+                break;
       }
     printf ("Active Voices            : %d\n", voices);
     printf ("Maximum Number of Voices : %d\n", max_voices);
@@ -622,7 +624,7 @@ print_usage()
   printf ("\n");
   printf ("Options:\n");
   printf ("  --debug         enable debugging output\n");
-  printf ("  --quality       set sample playback quality (1-3) [3]\n");
+  printf ("  --quality       set sample playback quality (1-4) [3]\n");
   printf ("  --preload-time  set sample preload time in milliseconds [500]\n");
 }
 
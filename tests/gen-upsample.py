@@ -42,5 +42,22 @@ def fir():
         if (c >= 0 and c < width):
             print ("  o1 += in (x + %d) * %.17gf;" % (i, coeffs[c] * 2))
 
+def halfband_table():
+    coeffs = signal.windows.kaiser (45, 7, sym=True)
+    width = len (coeffs)
+    center = width // 2
+
+    values = []
+    for i in range (0, width):
+        c = center + i
+        if (c >= 0 and c < width):
+            coeffs[c] *= sinc (i * 0.5) * 0.5
+            if (c & 1):
+                values.append ("%.17gf" % (coeffs[c] * 2))
+    for i in range (0, len (values), 4):
+        print ("  " + ", ".join (values[i:i + 4]) + ("," if i + 4 < len (values) else ""))
+
 print ("  // ---- generated code by gen-upsample.py ----");
 halfband_fir()
+print ("  // ---- generated table by gen-upsample.py ----");
+halfband_table()
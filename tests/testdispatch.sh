@@ -0,0 +1,11 @@
+#!/bin/sh
+# The DSP kernels are built for AVX2 and selected at runtime (see LIQUIDSFZ_CPU_DISPATCH),
+# the output must be identical to the output of a library built without cpu dispatch.
+
+set -e
+
+./testrender testrender-dispatch.raw
+./testrender-nodispatch testrender-nodispatch.raw
+cmp testrender-dispatch.raw testrender-nodispatch.raw
+rm -f testrender-dispatch.raw testrender-nodispatch.raw
+echo "cpu dispatch output identical"
@@ -0,0 +1,453 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+#include "filter.hh"
+#include "envelope.hh"
+#include "synth.hh"
+#include "utils.hh"
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <unistd.h>
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+using namespace LiquidSFZInternal;
+
+using std::vector;
+using std::max;
+
+/* unit tests for the dsp building blocks, the synth itself is tested by testsynth */
+
+static double
+db (double x)
+{
+  return 20 * log10 (std::max (x, 0.00000001));
+}
+
+/* sine + sawtooth-like noise on the left channel, a different sine on the right channel */
+static void
+gen_test_signal (uint n_frames, vector<float>& left, vector<float>& right)
+{
+  left.resize (n_frames);
+  right.resize (n_frames);
+  for (uint i = 0; i < n_frames; i++)
+    {
+      left[i] = sin (i * 0.05) + ((i * 7919) % 97) / 97. - 0.5;
+      right[i] = cos (i * 0.13) * 0.7;
+    }
+}
+
+static float
+max_diff (const vector<float>& a, const vector<float>& b)
+{
+  assert (a.size() == b.size());
+
+  float diff = 0;
+  for (size_t i = 0; i < a.size(); i++)
+    diff = max (diff, fabs (a[i] - b[i]));
+  return diff;
+}
+
+static void
+test_filter_stereo()
+{
+  printf ("test stereo filter:\n");
+
+  const int sample_rate = 48000;
+  const uint n_frames = 1000;
+
+  vector<float> in_left, in_right;
+  gen_test_signal (n_frames, in_left, in_right);
+
+  for (auto type : { "lpf_1p", "hpf_1p", "lpf_2p", "hpf_2p", "bpf_2p", "brf_2p", "lpf_4p", "hpf_4p", "lpf_6p", "hpf_6p", "peq" })
+    {
+      /* left and right are processed in the lanes of one vector, this must give the same result as mono */
+      Filter stereo, mono_left, mono_right;
+      Filter::Type filter_type = Filter::type_from_string (type);
+      stereo.reset (filter_type, sample_rate);
+      mono_left.reset (filter_type, sample_rate);
+      mono_right.reset (filter_type, sample_rate);
+
+      vector<float> left = in_left, right = in_right, mleft = in_left, mright = in_right;
+      for (uint pos = 0; pos < n_frames; pos += 100)
+        {
+          /* changing the cutoff also tests the state after coefficient updates */
+          float cutoff = 500 + pos * 3;
+          if (filter_type == Filter::Type::PEQ)
+            {
+              stereo.process_peq (&left[pos], &right[pos], cutoff, 2, 6, 100);
+              mono_left.process_peq_mono (&mleft[pos], cutoff, 2, 6, 100);
+              mono_right.process_peq_mono (&mright[pos], cutoff, 2, 6, 100);
+            }
+          else
+            {
+              stereo.process (&left[pos], &right[pos], cutoff, 3, 100);
+              mono_left.process_mono (&mleft[pos], cutoff, 3, 100);
+              mono_right.process_mono (&mright[pos], cutoff, 3, 100);
+            }
+        }
+      float peak = 0;
+      for (uint i = 0; i < n_frames; i++)
+        peak = max (peak, max (fabs (left[i]), fabs (right[i])));
+
+      const float diff = max (max_diff (left, mleft), max_diff (right, mright));
+      printf (" - %-6s peak=%.3f max_diff=%g\n", type, peak, diff);
+      assert (peak > 0.01 && peak < 10);
+      assert (diff < 1e-6);
+    }
+}
+
+static void
+test_filter_design()
+{
+  printf ("test filter design:\n");
+
+  /* a two pole lowpass filter has a gain of q at the cutoff frequency */
+  auto check_gain = [] (float cutoff, float resonance)
+    {
+      const int sample_rate = 48000;
+      const uint n_frames = sample_rate * 2;
+
+      vector<float> samples (n_frames);
+      for (uint i = 0; i < n_frames; i++)
+        samples[i] = sin (i * 2 * M_PI * cutoff / sample_rate);
+
+      Filter filter;
+      filter.reset (Filter::Type::LPF_2P, sample_rate);
+      filter.process_mono (samples.data(), cutoff, resonance, n_frames);
+
+      /* measure rms of the last half second */
+      double energy = 0;
+      for (uint i = n_frames / 4 * 3; i < n_frames; i++)
+        energy += samples[i] * samples[i];
+      double gain_db = db (sqrt (energy / (n_frames / 4) * 2));
+      printf (" - cutoff=%.0f resonance=%.1f gain=%.3f\n", cutoff, resonance, gain_db);
+      assert (fabs (gain_db - resonance) < 0.02);
+    };
+  for (auto cutoff : { 200, 440, 2500, 9000, 16000 })
+    {
+      for (auto resonance : { -3, 0, 7, 24, 42 })
+        check_gain (cutoff, resonance);
+    }
+}
+
+static void
+test_filter_cascade()
+{
+  printf ("test filter cascade:\n");
+
+  const int sample_rate = 48000;
+  const uint n_frames = 5000;
+
+  for (int channels = 1; channels <= 2; channels++)
+    {
+      vector<float> left, right;
+      gen_test_signal (n_frames, left, right);
+      vector<float> c_left = left, c_right = right;
+
+      Filter f1, f2, eq, c_f1, c_f2, c_eq;
+      FilterCascade cascade;
+      f1.reset (Filter::Type::LPF_6P, sample_rate);
+      f2.reset (Filter::Type::HPF_1P, sample_rate);
+      eq.reset (Filter::Type::PEQ, sample_rate);
+      c_f1.reset (Filter::Type::LPF_6P, sample_rate);
+      c_f2.reset (Filter::Type::HPF_1P, sample_rate);
+      c_eq.reset (Filter::Type::PEQ, sample_rate);
+      cascade.reset();
+
+      uint pos = 0;
+      for (uint block = 0; pos < n_frames; block++)
+        {
+          /* odd block sizes, so config positions don't line up with the block start */
+          const uint block_size = std::min ((block * 37) % 101 + 1, n_frames - pos);
+          auto cr1 = [&] (int i) { return Filter::CR (1000 + (pos + i) * 0.7, 6); };
+          auto cr2 = [&] (int i) { return Filter::CR (200, 0); };
+
+          uint config_pos[FilterCascade::max_config_positions (101)];
+          Filter::CR cascade_cr1[FilterCascade::max_config_positions (101)];
+          Filter::CR cascade_cr2[FilterCascade::max_config_positions (101)];
+          uint n_config_pos = cascade.config_positions (block_size, config_pos);
+          for (uint c = 0; c < n_config_pos; c++)
+            {
+              cascade_cr1[c] = cr1 (config_pos[c]);
+              cascade_cr2[c] = cr2 (config_pos[c]);
+            }
+          cascade.clear();
+          cascade.add_filter (c_f1, cascade_cr1);
+          cascade.add_filter (c_f2, cascade_cr2);
+          cascade.add_peq (c_eq, 2000, 1, 6);
+          if (channels == 2)
+            {
+              f1.process_mod (&left[pos], &right[pos], cr1, block_size);
+              f2.process_mod (&left[pos], &right[pos], cr2, block_size);
+              eq.process_peq (&left[pos], &right[pos], 2000, 1, 6, block_size);
+              cascade.process (&c_left[pos], &c_right[pos], block_size);
+            }
+          else
+            {
+              f1.process_mod_mono (&left[pos], cr1, block_size);
+              f2.process_mod_mono (&left[pos], cr2, block_size);
+              eq.process_peq_mono (&left[pos], 2000, 1, 6, block_size);
+              cascade.process_mono (&c_left[pos], block_size);
+            }
+          pos += block_size;
+        }
+      const float diff = max (max_diff (left, c_left), max_diff (right, c_right));
+      printf (" - channels=%d max_diff=%g\n", channels, diff);
+      assert (diff == 0);
+    }
+}
+
+static void
+test_linear_smooth_block()
+{
+  printf ("test linear smooth block:\n");
+
+  LinearSmooth smooth, block_smooth;
+  for (auto *s : { &smooth, &block_smooth })
+    {
+      s->reset (48000, 0.02);
+      s->set (1, true);
+    }
+  vector<float> values, block_values;
+  uint block = 1;
+  for (int i = 0; i < 200; i++)
+    {
+      if (i % 7 == 0) // new target, sometimes in the middle of a ramp
+        {
+          smooth.set (i * 0.01);
+          block_smooth.set (i * 0.01);
+        }
+      const size_t pos = values.size();
+      block_values.resize (pos + block);
+      block_smooth.process (&block_values[pos], block);
+      for (uint k = 0; k < block; k++)
+        values.push_back (smooth.get_next());
+      assert (smooth.is_constant() == block_smooth.is_constant());
+
+      block = block % 500 + 37;
+    }
+  const float diff = max_diff (values, block_values);
+  printf (" - max diff %g\n", diff);
+  assert (diff < 1e-4); // get_next() accumulates rounding errors over the ramp, process() doesn't
+}
+
+static void
+test_envelope_block()
+{
+  printf ("test envelope block:\n");
+
+  const int sample_rate = 48000;
+  Region region;
+
+  for (auto shape : { Envelope::Shape::EXPONENTIAL, Envelope::Shape::LINEAR })
+    {
+      Envelope env, block_env;
+      for (Envelope *e : { &env, &block_env })
+        {
+          e->set_shape (shape);
+          e->set_delay (0.001);
+          e->set_attack (0.01);
+          e->set_hold (0.002);
+          e->set_decay (0.05);
+          e->set_sustain (40);
+          e->set_release (0.1);
+          e->start (region, sample_rate);
+        }
+      vector<float> values, block_values;
+      uint block = 1;
+      while (!env.done())
+        {
+          const size_t pos = values.size();
+          if (pos >= 5000 && pos < 5000 + block) // release
+            {
+              env.stop (OffMode::NORMAL);
+              block_env.stop (OffMode::NORMAL);
+            }
+          block_values.resize (pos + block);
+          uint n_active = block_env.process (&block_values[pos], block);
+          uint expect_active = block;
+          for (uint i = 0; i < block; i++)
+            {
+              if (env.done() && expect_active == block)
+                expect_active = i;
+              values.push_back (env.get_next());
+            }
+          assert (n_active == expect_active);
+          assert (env.done() == block_env.done());
+
+          block = block % 300 + 37;
+        }
+      const float diff = max_diff (values, block_values);
+      printf (" - %s: max diff %g\n", shape == Envelope::Shape::LINEAR ? "linear" : "exponential", diff);
+      assert (diff < 1e-5);
+    }
+}
+
+/* reference lfo wave forms, evaluated once per control block */
+struct RefLFO
+{
+  Synth  *synth = nullptr;
+  int     wave = 0;
+  float   phase = 0;
+  float   sh_value = 0;
+  int     last_sh_state = -1;
+
+  float
+  eval()
+  {
+    switch (wave)
+      {
+        case 0:  if (phase < 0.25) return phase * 4;
+                 if (phase < 0.75) return 2 - phase * 4;
+                 return -4 + phase * 4;
+        case 1:  return sinf (phase * 2 * M_PI);
+        case 2:  return phase < 0.75 ? 1 : 0;
+        case 3:  return phase < 0.5 ? 1 : 0;
+        case 4:  return phase < 0.25 ? 1 : 0;
+        case 5:  return phase < 0.125 ? 1 : 0;
+        case 6:  return phase * 2 - 1;
+        case 7:  return 1 - phase * 2;
+        case 12: if (last_sh_state != (phase < 0.5))
+                   {
+                     sh_value = synth->normalized_random_value() * 2 - 1;
+                     last_sh_state = phase < 0.5;
+                   }
+                 return sh_value;
+      }
+    assert (false);
+    return 0;
+  }
+};
+
+static void
+test_lfo_smoothing()
+{
+  printf ("test lfo smoothing:\n");
+
+  /* the 2ms output smoothing is always enabled (there is no opcode to disable it) */
+  const uint n_frames = 10000;
+  const uint chunk    = 100; // process() restarts control blocks at the start of each chunk
+
+  Limits limits;
+  limits.max_lfos = 1;
+
+  for (int wave = 0; wave <= 12; wave++)
+    {
+      if (!LFOGen::supports_wave (wave))
+        continue;
+
+      Region region;
+      region.lfos.resize (1);
+      region.lfos[0].wave   = wave;
+      region.lfos[0].freq   = 7;
+      region.lfos[0].phase  = 0.3;
+      region.lfos[0].pitch  = 1200;
+      region.lfos[0].volume = 6;
+      region.lfos[0].cutoff = 2400;
+
+      /* both synths produce the same random values for the sample & hold wave */
+      Synth synth, ref_synth;
+      synth.set_random_seed (42);
+      ref_synth.set_random_seed (42);
+
+      LFOGen lfo_gen (&synth, nullptr, limits);
+      double max_err = 0;
+
+      /* starting the same LFOGen again with a new rate must update the smoothing */
+      for (int sample_rate : { 44100, 48000, 22050 })
+        {
+          lfo_gen.start (region, sample_rate);
+
+          RefLFO ref;
+          ref.synth = &ref_synth;
+          ref.wave  = wave;
+          ref.phase = region.lfos[0].phase;
+
+          const double a = exp2f (-1.f / int (0.002 * sample_rate));
+          double last[LFOGen::MAX_OUTPUTS];
+          bool first = true;
+
+          vector<float> buffer (chunk * LFOGen::MAX_OUTPUTS);
+          for (uint pos = 0; pos < n_frames; pos += chunk)
+            {
+              lfo_gen.process (buffer.data(), chunk);
+              for (uint block = 0; block < chunk; block += 32)
+                {
+                  const uint  todo = std::min (32u, chunk - block);
+                  const float value = ref.eval();
+                  const double target[LFOGen::MAX_OUTPUTS] = {
+                    exp2f (value),
+                    float (db_to_factor (value * 6)),
+                    exp2f (value * 2)
+                  };
+                  ref.phase += todo * 7.f / sample_rate;
+                  while (ref.phase > 1)
+                    ref.phase -= 1;
+
+                  /* old implementation: per sample recurrence (in double precision) */
+                  for (uint t = 0; t < LFOGen::MAX_OUTPUTS; t++)
+                    {
+                      auto type = LFOGen::OutputType (t);
+                      assert (lfo_gen.has_output (type));
+                      if (first)
+                        last[t] = target[t];
+                      for (uint k = 0; k < todo; k++)
+                        {
+                          last[t] = (1 - a) * target[t] + a * last[t];
+                          /* relative to the magnitude of the values we smooth between */
+                          const double err = fabs (lfo_gen.get (type)[block + k] - last[t]) / max (target[t], last[t]);
+                          max_err = max (max_err, err);
+                        }
+                    }
+                  first = false;
+                }
+            }
+        }
+      printf (" - wave=%-2d max_err=%g\n", wave, max_err);
+      assert (max_err < 1e-6);
+    }
+}
+
+static void
+test_render_pool()
+{
+  printf ("test render pool:\n");
+
+  for (uint n_threads : { 2, 3, 4 })
+    {
+      RenderPool pool;
+      pool.set_n_threads (n_threads);
+
+      /* every job must run exactly once, also if the workers sleep or are late */
+      vector<std::atomic<int>> counts (n_threads);
+      uint n_runs = 0;
+      for (int run = 0; run < 300; run++)
+        {
+          auto job = [&] (uint j) { counts[j]++; };
+          pool.run (job);
+          n_runs++;
+
+          for (uint j = 0; j < n_threads; j++)
+            assert (counts[j] == int (n_runs));
+          if (run % 50 == 0)
+            usleep (5000); // longer than the spin time: workers sleep on the semaphore
+        }
+      printf (" - threads %d: %d runs ok\n", n_threads, n_runs);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  test_filter_stereo();
+  test_filter_design();
+  test_filter_cascade();
+  test_linear_smooth_block();
+  test_envelope_block();
+  test_lfo_smoothing();
+  test_render_pool();
+}
@@ -0,0 +1,117 @@
+// This Source Code Form is licensed MPL-2.0: http://mozilla.org/MPL/2.0
+
+/* renders a fixed set of notes with all sample qualities and writes the raw
+ * output to a file; testdispatch.sh compares the output of this program with
+ * the output of the same program linked against a library built without
+ * runtime cpu dispatch
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+#include <sndfile.h>
+#include <vector>
+#include <string>
+
+#include "liquidsfz.hh"
+
+using std::vector;
+using std::string;
+using LiquidSFZ::Synth;
+
+static void
+write_sample (const string& filename, int sample_rate)
+{
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    {
+      samples.push_back (sin (i * 2 * M_PI * 440 / sample_rate) * 0.5 + ((i * 7919) % 97) / 97. * 0.2 - 0.1);
+      samples.push_back (sin (i * 2 * M_PI * 2900 / sample_rate) * 0.4);
+    }
+  SF_INFO sfinfo = {0,};
+  sfinfo.samplerate = sample_rate;
+  sfinfo.channels = 2;
+  sfinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+  SNDFILE *sndfile = sf_open (filename.c_str(), SFM_WRITE, &sfinfo);
+  assert (sndfile);
+
+  sf_count_t count = sf_writef_float (sndfile, &samples[0], samples.size() / 2);
+  assert (count == sf_count_t (samples.size() / 2));
+
+  sf_close (sndfile);
+}
+
+static void
+write_sfz (const string& filename)
+{
+  FILE *sfz_file = fopen (filename.c_str(), "w");
+  assert (sfz_file);
+
+  /* static filters (filter bus), modulated filters, eq, lfos, different playback speeds */
+  fprintf (sfz_file,
+    "<group>sample=testrender.wav pitch_keycenter=60 loop_mode=loop_continuous ampeg_release=0.1\n"
+    "<region>lokey=20 hikey=59 fil_type=lpf_2p cutoff=2000 resonance=6\n"
+    "<region>lokey=60 hikey=69 fil_type=hpf_4p cutoff=500 cutoff_oncc1=2400 eq1_freq=3000 eq1_gain=6\n"
+    "<region>lokey=70 hikey=127 lfo1_freq=5 lfo1_pitch=50 lfo2_freq=3 lfo2_cutoff=1200 fil_type=lpf_6p cutoff=4000 width=60\n");
+  fclose (sfz_file);
+}
+
+int
+main (int argc, char **argv)
+{
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: testrender <output.raw>\n");
+      return 1;
+    }
+  const int sample_rate = 48000;
+  write_sample ("testrender.wav", 44100);
+  write_sfz ("testrender.sfz");
+
+  FILE *out_file = fopen (argv[1], "w");
+  assert (out_file);
+
+  for (int quality = 1; quality <= 4; quality++)
+    {
+      Synth synth;
+      synth.set_sample_rate (sample_rate);
+      synth.set_live_mode (false);
+      synth.set_sample_quality (quality);
+      if (!synth.load ("testrender.sfz"))
+        {
+          fprintf (stderr, "parse error: exiting\n");
+          return 1;
+        }
+      vector<float> out_left (1000), out_right (1000);
+      float *outputs[2] = { out_left.data(), out_right.data() };
+
+      for (int block = 0; block < 60; block++)
+        {
+          if (block == 0)
+            {
+              for (int key : { 36, 48, 60, 64, 67, 72, 79, 96 })
+                synth.add_event_note_on (0, 0, key, 100);
+            }
+          if (block == 10)
+            synth.add_event_cc (123, 0, 1, 100);
+          if (block == 20)
+            synth.add_event_pitch_bend (456, 0, 12000);
+          if (block == 30)
+            synth.add_event_note_off (789, 0, 64);
+          if (block == 40)
+            synth.add_event_pitch_bend (0, 0, 3000);
+          synth.process (outputs, out_left.size());
+
+          fwrite (out_left.data(), sizeof (float), out_left.size(), out_file);
+          fwrite (out_right.data(), sizeof (float), out_right.size(), out_file);
+        }
+    }
+  fclose (out_file);
+
+  unlink ("testrender.sfz");
+  unlink ("testrender.wav");
+}
@@ -229,6 +229,24 @@ freq_from_zero_crossings (const vector<float>& samples, int sample_rate)
   return zero_crossings * 0.5 * sample_rate / samples.size();
 }
 
+/* energy of everything except the partial at freq relative to the energy of the partial (in dB);
+ * the signal range must contain a whole number of periods of the partial
+ */
+double
+residual_db (const vector<float>& signal, size_t start, size_t n, double freq, int sample_rate)
+{
+  double re = 0, im = 0, energy = 0;
+  for (size_t i = start; i < start + n; i++)
+    {
+      const double phase = 2 * M_PI * freq * i / sample_rate;
+      re += signal[i] * cos (phase);
+      im += signal[i] * sin (phase);
+      energy += signal[i] * signal[i];
+    }
+  const double partial_energy = 2 * (re * re + im * im) / n;
+  return 10 * log10 (std::max (energy - partial_energy, 1e-20) / partial_energy);
+}
+
 SineDetectPartial
 max_partial (const vector<float>& samples, int sample_rate)
 {
@@ -315,7 +333,7 @@ test_tiny_loop()
       for (int c = 0; c < channels; c++)
         {
           printf ("test tiny loop %s (channel %d/%d)\n", channels == 1 ? "mono" : "stereo", c + 1, channels);
-          for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+          for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
             {
               synth.all_sound_off();
               synth.set_sample_quality (sample_quality);
@@ -338,6 +356,8 @@ test_tiny_loop()
                 amag_max = -69;
               if (sample_quality == 3)
                 amag_max = -77;
+              if (sample_quality == 4)
+                amag_max = -77;
 
               printf ("  - quality=%d freq=%f (expect %f) mag=%f | alias_freq=%f amag=%f (max %f)\n", sample_quality,
                   partials[0].freq, f_expect, db (partials[0].mag),
@@ -377,7 +397,7 @@ test_wav_loop()
           exit (1);
         }
       synth.set_gain (sqrt(2));
-      for (int quality = 1; quality <= 3; quality++)
+      for (int quality = 1; quality <= 4; quality++)
         {
           synth.all_sound_off();
           synth.set_sample_quality (quality);
@@ -449,6 +469,101 @@ test_wav_loop()
 #endif
 }
 
+vector<float>
+render_loop_seam (int quality, int key, int loop_start, int loop_end)
+{
+  write_sfz (string_printf ("<region>sample=testsynth.wav volume_cc7=0 pan_cc10=0 loop_mode=loop_continuous loop_start=%d loop_end=%d",
+                            loop_start, loop_end));
+  Synth synth;
+  synth.set_sample_rate (48000);
+  synth.set_live_mode (false);
+  synth.set_sample_quality (quality);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  synth.add_event_note_on (0, 0, key, 127);
+
+  vector<float> out_left (10000), out_right (10000);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+  synth.process (outputs, out_left.size());
+
+  vector<float> result = out_left;
+  result.insert (result.end(), out_right.begin(), out_right.end());
+  return result;
+}
+
+void
+test_loop_seam()
+{
+  printf ("test loop seam:\n");
+
+  /* A short loop wraps around many times, so the interpolator reads the frames
+   * around the loop points from the loop seam. The same sound is played by a
+   * long loop over many copies of the loop, where (within the rendered range)
+   * no wraparound happens, so the frames are read from the sample data.
+   *
+   * After the first wraparound, the frames before the loop start are always
+   * read from the loop end, so if the loop is shorter than the interpolator
+   * window, the short loop will sound different from the long loop (which
+   * still reads the frames before the loop start) for a few frames.
+   */
+  const int sample_rate = 48000;
+  for (int loop_start : { 0, 37 })
+    {
+      for (int loop_len : { 5, 17, 31, 100 })
+        {
+          const int n_copies = 20000 / loop_len + 1;
+          const int channels = 2;
+
+          auto frame = [] (int i, int c) -> float { return c == 0 ? sin (i * 0.7) * 0.5 + ((i * 7919) % 97) / 97. * 0.3 : cos (i * 0.3) * 0.4; };
+          vector<float> head, loop, tail;
+          for (int i = 0; i < loop_start; i++)
+            for (int c = 0; c < channels; c++)
+              head.push_back (frame (i + 1000, c));
+          for (int i = 0; i < loop_len; i++)
+            for (int c = 0; c < channels; c++)
+              loop.push_back (frame (i, c));
+          for (int i = 0; i < 50; i++) // after the loop end, must not be played
+            for (int c = 0; c < channels; c++)
+              tail.push_back (1);
+
+          auto sample = [&] (int copies)
+            {
+              vector<float> samples = head;
+              for (int k = 0; k < copies; k++)
+                samples.insert (samples.end(), loop.begin(), loop.end());
+              samples.insert (samples.end(), tail.begin(), tail.end());
+              return samples;
+            };
+          for (int quality = 1; quality <= 4; quality++)
+            {
+              float max_diff = 0;
+              for (int key : { 48, 60, 67 })
+                {
+                  write_sample (sample (n_copies), sample_rate, channels);
+                  auto ref = render_loop_seam (quality, key, loop_start, loop_start + n_copies * loop_len - 1);
+
+                  write_sample (sample (1), sample_rate, channels);
+                  auto out = render_loop_seam (quality, key, loop_start, loop_start + loop_len - 1);
+
+                  const double speed = exp2 ((key - 60) / 12.);
+                  for (size_t i = 0; i < ref.size(); i++)
+                    {
+                      const double pos = (i % (ref.size() / 2)) * speed;
+                      if (pos > loop_start + loop_len - 1 && pos < loop_start + 34)
+                        continue;
+                      max_diff = max (max_diff, fabs (out[i] - ref[i]));
+                    }
+                }
+              printf (" - loop_start=%d loop_len=%d quality=%d: max diff %g\n", loop_start, loop_len, quality, max_diff);
+              assert (max_diff < 1e-5);
+            }
+        }
+    }
+}
+
 void
 test_pitch()
 {
@@ -472,7 +587,7 @@ test_pitch()
       exit (1);
     }
   printf ("test pitch using cc\n");
-  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
     {
       synth.all_sound_off();
       synth.set_sample_quality (sample_quality);
@@ -512,7 +627,7 @@ test_pitch()
       exit (1);
     }
   printf ("simple pitch, pitch bend\n");
-  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
     {
       vector<float> out_left (sample_rate), out_right (sample_rate);
       float *outputs[2] = { out_left.data(), out_right.data() };
@@ -702,7 +817,7 @@ test_interp_time_align()
       exit (1);
     }
   printf ("test interpolation time align\n");
-  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
     {
       synth.all_sound_off();
       synth.set_sample_quality (sample_quality);
@@ -719,6 +834,128 @@ test_interp_time_align()
     }
 }
 
+struct BlockRenderEvent
+{
+  uint frame;
+  int  pitch_bend;
+};
+
+/* render one note, calling process() with the given (repeating) chunk sizes */
+vector<float>
+render_block_chunks (int quality, int key, const vector<uint>& chunks, const vector<BlockRenderEvent>& events)
+{
+  Synth synth;
+  synth.set_sample_rate (48000);
+  synth.set_live_mode (false);
+  synth.set_sample_quality (quality);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  synth.add_event_note_on (0, 0, key, 127);
+
+  const uint n_frames = 20000;
+  vector<float> out_left (n_frames), out_right (n_frames);
+  uint pos = 0;
+  for (size_t c = 0; pos < n_frames; c++)
+    {
+      const uint todo = std::min (chunks[c % chunks.size()], n_frames - pos);
+      for (auto event : events)
+        if (event.frame >= pos && event.frame < pos + todo)
+          synth.add_event_pitch_bend (event.frame - pos, 0, event.pitch_bend);
+
+      float *outputs[2] = { &out_left[pos], &out_right[pos] };
+      synth.process (outputs, todo);
+      pos += todo;
+    }
+  vector<float> result;
+  for (uint i = 0; i < n_frames; i++)
+    {
+      result.push_back (out_left[i]);
+      result.push_back (out_right[i]);
+    }
+  return result;
+}
+
+void
+test_block_render()
+{
+  printf ("test block render:\n");
+
+  /* stereo sample, 36000 / 48000 gives a playback speed of 0.75 (exact in binary) for the keycenter */
+  const int sample_rate = 36000;
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    {
+      samples.push_back (sin (i * 0.05) * 0.5 + ((i * 7919) % 97) / 97. * 0.2 - 0.1);
+      samples.push_back (cos (i * 0.13) * 0.7);
+    }
+  write_sample (samples, sample_rate, 2);
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 amp_veltrack=0 volume_cc7=0 pan_cc10=0 bend_up=1200 bend_down=-1200");
+
+  /* the output must not depend on how the frames are split into process() calls, odd chunk
+   * sizes make the 64 frame blocks of the interpolator start at different positions
+   */
+  const vector<uint> whole { 1024 };
+  const vector<uint> odd { 1, 7, 63, 64, 65, 129, 333, 2, 1000 };
+
+  /* without pitch bend events the position advances by a constant step */
+  const vector<BlockRenderEvent> const_speed;
+  const vector<BlockRenderEvent> varying_speed { { 3000, 12000 }, { 7777, 2000 }, { 12345, 8192 } };
+
+  for (int quality = 1; quality <= 4; quality++)
+    {
+      for (int key : { 48, 60, 67, 72 })
+        {
+          for (auto events : { const_speed, varying_speed })
+            {
+              auto ref = render_block_chunks (quality, key, whole, events);
+              auto out = render_block_chunks (quality, key, odd, events);
+
+              float max_diff = 0;
+              for (size_t i = 0; i < ref.size(); i++)
+                max_diff = max (max_diff, fabs (out[i] - ref[i]));
+
+              printf (" - quality %d, key %d, %s speed: max diff %g\n", quality, key, events.empty() ? "const" : "varying", max_diff);
+              /* quality 4 chooses the sinc band table from the average speed of each 64 frame block,
+               * so if the speed changes quickly, the position of the blocks makes a small difference
+               */
+              if (quality == 4 && !events.empty())
+                assert (max_diff < 0.02);
+              else
+                assert (max_diff < 1e-5);
+            }
+        }
+    }
+
+  /* quality 1: compare with linear interpolation computed from the sample data; the speeds
+   * 0.375, 0.75 and 1.5 are exact, so the positions are exact in 32.32 fixed point as well
+   */
+  for (int key : { 48, 60, 72 })
+    {
+      auto out = render_block_chunks (1, key, odd, const_speed);
+
+      const uint64_t step = uint64_t (0.75 * exp2 ((key - 60) / 12.) * 4294967296.0);
+      const float gain = sqrt (0.5); // constant power panning law, stereo sample with pan=0
+      float max_diff = 0;
+      for (size_t i = 0; i < out.size() / 2; i++)
+        {
+          const uint64_t pos = i * step;
+          const uint  ipos = pos >> 32;
+          const float frac = uint32_t (pos) * (1.f / 4294967296.f);
+          for (uint c = 0; c < 2; c++)
+            {
+              const float s0 = samples[ipos * 2 + c];
+              const float s1 = samples[(ipos + 1) * 2 + c];
+              max_diff = max (max_diff, fabs (out[i * 2 + c] - (s0 + frac * (s1 - s0)) * gain));
+            }
+        }
+      printf (" - quality 1, key %d: linear interpolation max diff %g\n", key, max_diff);
+      assert (max_diff < 1e-6);
+    }
+}
+
 void
 test_simple()
 {
@@ -963,7 +1200,7 @@ test_simple()
   assert (v136_min > -6.01 && v136_min < -4);
   assert (v136_max > 4 && v136_max < 6.01);
   printf ("silence trigger release test:\n");
-  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
     {
       write_sfz ("<region>trigger=attack sample=*silence"
                  "<region>trigger=release sample=testsynth.wav");
@@ -981,7 +1218,7 @@ test_simple()
       for (int i = 0; i < int (out_left.size()); i++)
         {
           float eps;
-          if (sample_quality == 3)
+          if (sample_quality >= 3)
             eps = 0.005;
           else
             eps = 0;
@@ -1116,7 +1353,7 @@ test_end()
   synth.set_sample_rate (sample_rate);
   synth.set_live_mode (false);
   printf ("test end opcode:\n");
-  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
     {
       for (int try_offset : { 0, 500 })
         {
@@ -1136,8 +1373,8 @@ test_end()
               int end_r = -1;
               for (size_t i = 0; i < out_left.size(); i++)
                 {
-                  // at quality 3, the interpolation will produce ripple after the end
-                  float threshold = (sample_quality == 3) ? 0.05 : 0;
+                  // at quality 3 and 4, the interpolation will produce ripple after the end
+                  float threshold = (sample_quality >= 3) ? 0.05 : 0;
 
                   if (out_left[i] > threshold)
                     end_l = i;
@@ -1232,17 +1469,564 @@ test_filter()
   chk_eq (1000, 2, 4);
 }
 
+void
+test_cc_range()
+{
+  printf ("test locc/hicc:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples (sample_rate);
+  write_sample (samples, sample_rate);
+  write_sfz ("<region>sample=testsynth.wav key=60 locc1=0 hicc1=63\n"
+             "<region>sample=testsynth.wav key=60 locc1=64 hicc1=127\n"
+             "<region>sample=testsynth.wav key=60 locc1=32 hicc1=95 locc2=100\n"
+             "<region>sample=testsynth.wav key=61");
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  vector<float> out_left (128), out_right (128);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+
+  struct Test { int cc1; int cc2; int key; uint expect; };
+  for (auto t : { Test { 0, 0, 60, 1 }, Test { 40, 0, 60, 1 }, Test { 40, 100, 60, 2 },
+                  Test { 64, 127, 60, 2 }, Test { 127, 127, 60, 1 }, Test { 127, 127, 61, 1 } })
+    {
+      synth.all_sound_off();
+      synth.add_event_cc (0, 0, 1, t.cc1);
+      synth.add_event_cc (0, 0, 2, t.cc2);
+      synth.add_event_note_on (0, 0, t.key, 100);
+      synth.process (outputs, out_left.size());
+
+      printf (" - cc1=%d cc2=%d key=%d: voices %d (expect %d)\n", t.cc1, t.cc2, t.key, synth.active_voice_count(), t.expect);
+      assert (synth.active_voice_count() == t.expect);
+    }
+}
+
+void
+test_off_by()
+{
+  printf ("test off_by:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples (sample_rate);
+  write_sample (samples, sample_rate);
+  write_sfz ("<group>off_mode=fast ampeg_release=0\n"
+             "<region>sample=testsynth.wav key=60 group=1 off_by=2\n"
+             "<region>sample=testsynth.wav key=61 group=2 off_by=3\n"
+             "<region>sample=testsynth.wav key=62 group=3\n"
+             "<region>sample=testsynth.wav key=63 group=4\n");
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  vector<float> out_left (4096), out_right (4096);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+
+  struct Test { int key; uint expect; };
+  for (auto t : { Test { 60, 1 }, Test { 60, 1 }, Test { 63, 2 }, Test { 61, 2 }, Test { 60, 3 }, Test { 62, 3 } })
+    {
+      synth.add_event_note_on (0, 0, t.key, 100);
+      synth.process (outputs, out_left.size());
+
+      printf (" - key=%d: voices %d (expect %d)\n", t.key, synth.active_voice_count(), t.expect);
+      assert (synth.active_voice_count() == t.expect);
+    }
+}
+
+vector<float>
+render_chord (int render_threads)
+{
+  int sample_rate = 44100;
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  synth.set_render_threads (render_threads);
+  synth.set_random_seed (42);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  for (int key = 40; key < 80; key++)
+    synth.add_event_note_on (0, 0, key, 100);
+
+  vector<float> out_left (sample_rate / 10), out_right (sample_rate / 10);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+  synth.process (outputs, out_left.size());
+
+  vector<float> result;
+  for (size_t i = 0; i < out_left.size(); i++)
+    {
+      result.push_back (out_left[i]);
+      result.push_back (out_right[i]);
+    }
+  return result;
+}
+
+void
+test_render_threads()
+{
+  printf ("test render threads:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 440 / sample_rate));
+  write_sample (samples, sample_rate);
+  /* the sample & hold lfo uses the synth random generator while rendering */
+  write_sfz ("<group>sample=testsynth.wav pitch_keycenter=60 pan=30 cutoff=2000 fil_type=lpf_2p"
+             "<region>lokey=20 hikey=59"
+             "<region>lokey=60 hikey=100 lfo1_wave=12 lfo1_freq=40 lfo1_pitch=300 lfo1_cutoff=1200");
+
+  auto ref = render_chord (1);
+  for (int render_threads : { 2, 3, 4 })
+    {
+      auto out = render_chord (render_threads);
+      auto out2 = render_chord (render_threads);
+
+      float max_diff = 0;
+      for (size_t i = 0; i < ref.size(); i++)
+        max_diff = max (max_diff, fabs (out[i] - ref[i]));
+
+      printf (" - threads %d: max diff %g, deterministic: %s\n", render_threads, max_diff, out == out2 ? "yes" : "no");
+      assert (max_diff < 1e-4);
+      assert (out == out2);
+    }
+}
+
+void
+test_filter_bus()
+{
+  printf ("test filter bus:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 440 / sample_rate) + 0.3 * sin (i * 2 * M_PI * 2900 / sample_rate));
+  write_sample (samples, sample_rate);
+
+  auto render = [&] (const string& control, const string& fil_opcodes)
+    {
+      /* the voices of the two regions share one filter bus, the third region has a different filter,
+       * the silent fourth region (on the bus of the third region) chokes the voices of the first two
+       * regions with off_mode=fast
+       */
+      write_sfz (control + "<group>pitch_keycenter=60 loop_mode=loop_continuous ampeg_release=0.05 " + fil_opcodes +
+                 "<region>sample=testsynth.wav lokey=20 hikey=59 pan=-40 group=1 off_by=2"
+                 "<region>sample=testsynth.wav lokey=60 hikey=100 width=50 group=1 off_by=2"
+                 "<region>sample=testsynth.wav lokey=101 hikey=119 fil_type=hpf_2p cutoff=800"
+                 "<region>sample=testsynth.wav lokey=120 hikey=127 fil_type=hpf_2p cutoff=800 amplitude=0 group=2");
+
+      Synth synth;
+      synth.set_sample_rate (sample_rate);
+      synth.set_live_mode (false);
+      if (!synth.load ("testsynth.sfz"))
+        {
+          fprintf (stderr, "parse error: exiting\n");
+          exit (1);
+        }
+      vector<float> out_left (1000), out_right (1000);
+      float *outputs[2] = { out_left.data(), out_right.data() };
+
+      vector<float> result;
+      for (int block = 0; block < 50; block++)
+        {
+          if (block == 0)
+            {
+              for (int key : { 48, 60, 64, 67, 110 })
+                synth.add_event_note_on (0, 0, key, 100);
+            }
+          /* volume and pan changes while the notes are held */
+          if (block == 5)
+            synth.add_event_cc (300, 0, 7, 60);
+          if (block == 7)
+            synth.add_event_cc (100, 0, 10, 20);
+          if (block == 8)
+            synth.add_event_cc (700, 0, 2, 90);
+          if (block == 10)
+            synth.add_event_note_off (123, 0, 64);
+          if (block == 20)
+            synth.add_event_note_on (456, 0, 72, 50);
+          if (block == 30)
+            synth.set_gain (0.5);
+          if (block == 25)
+            synth.add_event_note_off (0, 0, 110);
+          /* the filter bus must not ring out after choked voices or all sound off */
+          if (block == 35)
+            synth.add_event_note_on (200, 0, 120, 100);
+          if (block == 40)
+            synth.add_event_note_on (0, 0, 48, 100);
+          if (block == 45)
+            synth.all_sound_off();
+          synth.process (outputs, out_left.size());
+          for (size_t i = 0; i < out_left.size(); i++)
+            {
+              result.push_back (out_left[i]);
+              result.push_back (out_right[i]);
+            }
+        }
+      return result;
+    };
+  /* cutoff_oncc1=0 doesn't change the sound but makes the filter parameters dynamic, so each voice is filtered separately */
+  for (string control : { "", "<control>label_cc7=Volume label_cc10=Pan " })
+    {
+      for (string filter : { "fil_type=lpf_2p cutoff=1500 resonance=6",
+                             "fil_type=bpf_2p cutoff=900 fil2_type=lpf_4p cutoff2=4000",
+                             "fil_type=lpf_2p cutoff=1500 resonance=6 volume_oncc2=-12 pan_oncc2=50 amplitude_oncc2=50",
+                             "fil_type=lpf_2p cutoff=1500 resonance=6 width_oncc2=-100" })
+        {
+          auto ref = render (control, filter + " cutoff_oncc1=0");
+          auto out = render (control, filter);
+
+          float max_diff = 0;
+          for (size_t i = 0; i < ref.size(); i++)
+            max_diff = max (max_diff, fabs (out[i] - ref[i]));
+
+          /* the voices are choked at frame 35200 and fade out within 30ms, all sound off at frame 45000 */
+          float silence_peak = 0;
+          for (size_t i = 0; i < ref.size() / 2; i++)
+            if ((i >= 37000 && i < 40000) || i >= 45000)
+              silence_peak = max (silence_peak, max (fabs (out[i * 2]), fabs (out[i * 2 + 1])));
+
+          printf (" - %s%s: max diff %g, silence peak %g\n", control.c_str(), filter.c_str(), max_diff, silence_peak);
+          assert (max_diff < 1e-4);
+          assert (silence_peak == 0);
+        }
+    }
+}
+
+vector<float>
+render_half_rate (bool half_rate_samples, int sample_quality, int key)
+{
+  int sample_rate = 44100;
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  synth.set_sample_quality (sample_quality);
+  synth.set_half_rate_samples (half_rate_samples);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  assert (synth.cache_file_count() == (half_rate_samples ? 2 : 1));
+
+  synth.add_event_note_on (0, 0, key, 127);
+
+  vector<float> out_left (sample_rate), out_right (sample_rate);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+  synth.process (outputs, out_left.size());
+
+  return out_left;
+}
+
+void
+test_half_rate()
+{
+  printf ("test half rate samples:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < 2 * sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 441 / sample_rate));
+  write_sample (samples, sample_rate);
+
+  /* the loop length is a multiple of the sine period */
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 offset=101 loop_mode=loop_continuous loop_start=1000 loop_end=4999");
+
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
+    {
+      for (int key : { 66, 84 })
+        {
+          auto ref = render_half_rate (false, sample_quality, key);
+          auto out = render_half_rate (true, sample_quality, key);
+
+          float max_diff = 0;
+          for (size_t i = 0; i < ref.size(); i++)
+            max_diff = max (max_diff, fabs (out[i] - ref[i]));
+
+          printf (" - quality %d, key %d: max diff %g\n", sample_quality, key, max_diff);
+          if (key == 66) // below one octave up: the original sample is played
+            assert (max_diff == 0);
+          else
+            assert (max_diff < 0.001);
+        }
+    }
+
+  /* a 14700 Hz partial played one octave up folds back to 14700 Hz, the half rate copy doesn't contain it */
+  samples.clear();
+  for (int i = 0; i < 2 * sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 441 / sample_rate) * 0.5 + sin (i * 2 * M_PI * 14700 / sample_rate) * 0.5);
+  write_sample (samples, sample_rate);
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 loop_mode=loop_continuous loop_start=1000 loop_end=3999");
+
+  for (int sample_quality = 1; sample_quality <= 3; sample_quality++)
+    {
+      const double full_rate_alias = residual_db (render_half_rate (false, sample_quality, 72), 4410, 22050, 882, sample_rate);
+      const double half_rate_alias = residual_db (render_half_rate (true, sample_quality, 72), 4410, 22050, 882, sample_rate);
+
+      printf (" - quality %d, key 72: aliasing %.1f dB, with half rate samples %.1f dB\n", sample_quality, full_rate_alias, half_rate_alias);
+      assert (full_rate_alias > -10);
+      assert (half_rate_alias < -60);
+    }
+}
+
+void
+test_sinc_aliasing()
+{
+  printf ("test sinc aliasing:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 882 / sample_rate) * 0.5 + sin (i * 2 * M_PI * 8820 / sample_rate) * 0.5);
+  write_sample (samples, sample_rate);
+
+  /* two octaves up, the 8820 Hz partial is at 35280 Hz, which folds back to 8820 Hz */
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 loop_mode=loop_continuous loop_start=1000 loop_end=40999");
+
+  double min_alias = 0;
+  for (int sample_quality = 1; sample_quality <= 4; sample_quality++)
+    {
+      const double alias = residual_db (render_half_rate (false, sample_quality, 84), 4410, 22050, 3528, sample_rate);
+      printf (" - quality %d, key 84: aliasing %.1f dB\n", sample_quality, alias);
+      if (sample_quality < 4)
+        {
+          min_alias = std::min (min_alias, alias);
+        }
+      else
+        {
+          /* the sinc cutoff is lowered for high playback speeds */
+          assert (alias < -60);
+          assert (alias < min_alias - 50);
+        }
+    }
+}
+
+vector<float>
+render_preload_all (bool preload_all, size_t expect_cache_size)
+{
+  int sample_rate = 44100;
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  synth.set_preload_time (100);
+  synth.set_preload_all (preload_all);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  printf (" - preload_all=%d: cache size %zd (expect %zd)\n", preload_all, synth.cache_size(), expect_cache_size);
+  assert (synth.cache_size() == expect_cache_size);
+
+  synth.add_event_note_on (0, 0, 60, 127);
+  synth.add_event_note_on (0, 0, 67, 127);
+
+  vector<float> out_left (sample_rate), out_right (sample_rate);
+  float *outputs[2] = { out_left.data(), out_right.data() };
+  synth.process (outputs, out_left.size());
+
+  return out_left;
+}
+
+void
+test_preload_all()
+{
+  printf ("test preload all:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < 2 * sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 441 / sample_rate));
+  write_sample (samples, sample_rate);
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 loop_mode=loop_continuous loop_start=1000 loop_end=80999");
+
+  /* streaming: preload 100ms = 5 buffers with 1000 frames + overlap, preload all: one buffer with padding */
+  auto ref = render_preload_all (false, 5 * (1000 + 64) * sizeof (float));
+  auto out = render_preload_all (true, (samples.size() + 2 * 64) * sizeof (float));
+  assert (out == ref);
+}
+
+vector<float>
+render_adaptive_quality (bool adaptive_quality, int sample_quality)
+{
+  int sample_rate = 44100;
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  synth.set_sample_quality (sample_quality);
+  synth.set_adaptive_quality (adaptive_quality);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  synth.add_event_note_on (0, 0, 67, 127);
+
+  /* quiet (-70 dB) for 1 s, then loud again */
+  vector<float> out_left (sample_rate * 2), out_right (sample_rate * 2);
+  for (int part = 0; part < 2; part++)
+    {
+      float *outputs[2] = { out_left.data() + part * sample_rate, out_right.data() + part * sample_rate };
+      synth.add_event_cc (0, 0, 1, part == 0 ? 0 : 127);
+      synth.process (outputs, sample_rate);
+    }
+  return out_left;
+}
+
+vector<float>
+render_quality_switch (bool adaptive_quality, int sample_quality)
+{
+  int sample_rate = 44100;
+
+  Synth synth;
+  synth.set_sample_rate (sample_rate);
+  synth.set_live_mode (false);
+  synth.set_sample_quality (sample_quality);
+  synth.set_adaptive_quality (adaptive_quality);
+  if (!synth.load ("testsynth.sfz"))
+    {
+      fprintf (stderr, "parse error: exiting\n");
+      exit (1);
+    }
+  synth.add_event_cc (0, 0, 1, 127);
+  synth.add_event_note_on (0, 0, 60, 127);
+
+  /* loud for 0.1 s, then quiet (-70 dB) */
+  vector<float> out_left (sample_rate), out_right (sample_rate);
+  for (int part = 0; part < 2; part++)
+    {
+      const int start = part * sample_rate / 10;
+      const int end = part ? sample_rate : sample_rate / 10;
+      float *outputs[2] = { out_left.data() + start, out_right.data() + start };
+      synth.add_event_cc (0, 0, 1, part == 0 ? 127 : 0);
+      synth.process (outputs, end - start);
+    }
+  return out_left;
+}
+
+void
+test_adaptive_quality()
+{
+  printf ("test adaptive quality:\n");
+
+  int sample_rate = 44100;
+  vector<float> samples;
+  for (int i = 0; i < sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 441 / sample_rate) * 0.5 + sin (i * 2 * M_PI * 6615 / sample_rate) * 0.5);
+  write_sample (samples, sample_rate);
+  write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 loop_mode=loop_continuous loop_start=1000 loop_end=40999 volume=-70 gain_oncc1=70");
+
+  for (int sample_quality : { 2, 3, 4 })
+    {
+      auto ref = render_adaptive_quality (false, sample_quality);
+      auto out = render_adaptive_quality (true, sample_quality);
+
+      /* the quiet part is rendered with linear interpolation, the loud part must continue at the same position */
+      float quiet_diff = 0, loud_diff = 0;
+      for (int i = sample_rate / 10; i < sample_rate; i++)
+        quiet_diff = max (quiet_diff, fabs (out[i] - ref[i]));
+      for (int i = sample_rate + sample_rate / 10; i < 2 * sample_rate; i++)
+        loud_diff = max (loud_diff, fabs (out[i] - ref[i]));
+
+      printf (" - quality %d: quiet diff %g, loud diff %g\n", sample_quality, quiet_diff, loud_diff);
+      assert (quiet_diff > 0 && quiet_diff < 1e-4);
+      assert (loud_diff < 1e-5);
+    }
+
+  /* the 6615 Hz partial is transposed to 9911 Hz, boosting it by 40 dB (filter) or 24 dB (eq) makes the quiet part audible */
+  for (string boost : { "fil_type=lpf_2p cutoff=9911 resonance=40", "eq1_freq=9911 eq1_bw=0.5 eq1_gain=24" })
+    {
+      write_sfz ("<region>sample=testsynth.wav pitch_keycenter=60 loop_mode=loop_continuous loop_start=1000 loop_end=40999 volume=-70 gain_oncc1=70 " + boost);
+
+      auto ref = render_adaptive_quality (false, 3);
+      auto out = render_adaptive_quality (true, 3);
+
+      float max_diff = 0;
+      for (size_t i = 0; i < out.size(); i++)
+        max_diff = max (max_diff, fabs (out[i] - ref[i]));
+
+      printf (" - %s: max diff %g\n", boost.c_str(), max_diff);
+      assert (max_diff == 0);
+    }
+
+  /* the switch to linear interpolation crossfades the interpolators: for a low
+   * frequency signal played at almost the original speed, the difference to the
+   * non adaptive render changes slowly, so switching without crossfade would
+   * cause a step in the difference
+   */
+  samples.clear();
+  for (int i = 0; i < sample_rate; i++)
+    samples.push_back (sin (i * 2 * M_PI * 882 / sample_rate) * 0.5);
+  write_sample (samples, sample_rate);
+
+  for (int tune : { 37, 50, 71 })
+    {
+      write_sfz (string_printf ("<region>sample=testsynth.wav pitch_keycenter=60 tune=%d loop_mode=loop_continuous loop_start=1000 loop_end=40999 volume=-70 gain_oncc1=70", tune));
+      for (int sample_quality : { 2, 3, 4 })
+        {
+          auto ref = render_quality_switch (false, sample_quality);
+          auto out = render_quality_switch (true, sample_quality);
+
+          /* the first difference occurs at the quality switch */
+          size_t switch_pos = 1;
+          while (switch_pos < out.size() && out[switch_pos] == ref[switch_pos])
+            switch_pos++;
+          assert (switch_pos > size_t (sample_rate / 10) && switch_pos + 1000 < out.size());
+
+          auto max_diff_step = [&] (size_t start, size_t end)
+            {
+              float max_step = 0;
+              for (size_t i = start; i < end; i++)
+                max_step = max (max_step, fabs ((out[i] - ref[i]) - (out[i - 1] - ref[i - 1])));
+              return max_step;
+            };
+          const float switch_step = max_diff_step (switch_pos, switch_pos + 128);
+          const float quiet_step = max_diff_step (switch_pos + 128, out.size());
+
+          printf (" - quality %d, tune %d: max step at quality switch %g, after quality switch %g\n", sample_quality, tune, switch_step, quiet_step);
+          assert (switch_step < 1.1 * quiet_step);
+        }
+    }
+}
+
 int
 main (int argc, char **argv)
 {
   test_simple();
   test_interp_time_align();
+  test_block_render();
   test_tiny_loop();
   test_wav_loop();
+  test_loop_seam();
   test_pitch();
   test_width();
   test_end();
   test_filter();
+  test_cc_range();
+  test_off_by();
+  test_render_threads();
+  test_filter_bus();
+  test_half_rate();
+  test_sinc_aliasing();
+  test_preload_all();
+  test_adaptive_quality();
 
   unlink ("testsynth.sfz");
   unlink ("testsynth.wav");